@@ -1,129 +1,1360 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
+#include <limits.h>
 #include "sqlite3.h"
 
 #include "Database.h"
 
-static sqlite3 *db;
+#include <pthread.h>
 
-bool database_init(const char *db_path) {
-    if (sqlite3_open(db_path, &db) != SQLITE_OK) {
-        fprintf(stderr, "Ошибка открытия БД: %s\n", sqlite3_errmsg(db));
+#ifdef _WIN32
+    #include <windows.h>
+    #define SleepMs(ms) Sleep(ms)
+#else
+    #include <unistd.h>
+    #define SleepMs(ms) usleep((ms) * 1000)
+#endif
+
+#define DATABASE_SCHEMA_VERSION  4      // 1 - temperature_log, 2 - temperature_samples, 3 - агрегаты при вставке,
+                                        // 4 - месячные разделы
+#define ARCHIVE_TABLE            "temperature_samples"
+#define PARTITION_NAME_SIZE      32
+#define MIGRATION_CHUNK_ROWS     10000
+#define MIGRATION_PAUSE_MS       10     // пауза между порциями, чтобы не мешать записи
+#define DATABASE_BUSY_TIMEOUT_MS 5000
+#define DATABASE_READ_CONNECTIONS 4
+
+typedef enum {
+    STATEMENT_BEGIN,
+    STATEMENT_COMMIT,
+    STATEMENT_ROLLBACK,
+    STATEMENT_INSERT_TEMPERATURE,
+    STATEMENT_INSERT_ROLLUP,
+    STATEMENT_GET_LAST_TEMPERATURE,
+    STATEMENT_GET_TEMPERATURES,
+    STATEMENT_GET_SENSOR_TEMPERATURES,
+    STATEMENT_GET_ROLLUPS,
+    STATEMENT_GET_SENSOR_ROLLUPS,
+    // Пока идёт перенос старой таблицы, чтение объединяет обе
+    STATEMENT_GET_LAST_TEMPERATURE_MIGRATING,
+    STATEMENT_GET_TEMPERATURES_MIGRATING,
+    STATEMENT_GET_SENSOR_TEMPERATURES_MIGRATING,
+    STATEMENT_COUNT
+} DatabaseStatement;
+
+#define STATEMENT_FIRST_MIGRATING STATEMENT_GET_LAST_TEMPERATURE_MIGRATING
+
+static const char *statementNames[STATEMENT_COUNT] = {
+    "begin", "commit", "rollback", "insert_temperature", "insert_rollup",
+    "get_last_temperature", "get_temperatures", "get_sensor_temperatures", "get_rollups", "get_sensor_rollups",
+    "get_last_temperature_migrating", "get_temperatures_migrating", "get_sensor_temperatures_migrating"
+};
+
+// Слияние по формуле Чана: так дозапись корзины из следующей пачки или переноса не теряет данные
+#define ROLLUP_MERGE \
+    "ON CONFLICT (resolution, sensor, bucket_start) DO UPDATE SET " \
+    "m2 = m2 + excluded.m2 + (excluded.mean - mean) * (excluded.mean - mean) * count * excluded.count / (count + excluded.count), " \
+    "mean = mean + (excluded.mean - mean) * excluded.count / (count + excluded.count), " \
+    "count = count + excluded.count, " \
+    "sum = sum + excluded.sum, " \
+    "min = MIN(min, excluded.min), " \
+    "max = MAX(max, excluded.max);"
+
+#define ROLLUP_COLUMNS "resolution, sensor, bucket_start, bucket_end, count, sum, min, max, mean, m2"
+
+#define RANGE_START "strftime('%s', ?1 || ' 00:00:00')"
+#define RANGE_END   "strftime('%s', ?2 || ' 23:59:59')"
+
+#define SAMPLES_COLUMNS \
+    "sensor INTEGER NOT NULL, timestamp INTEGER NOT NULL, seq INTEGER NOT NULL, temperature REAL NOT NULL, " \
+    "PRIMARY KEY (sensor, timestamp, seq)"
+
+static const char *statementSql[STATEMENT_COUNT] = {
+    // Сразу берём блокировку записи: отложенная транзакция при конкуренции с переносом
+    // получила бы SQLITE_BUSY без ожидания
+    "BEGIN IMMEDIATE TRANSACTION;",
+    "COMMIT;",
+    "ROLLBACK;",
+
+    // seq различает отсчёты одного датчика в одну секунду; подзапрос - поиск по первичному ключу
+    "INSERT INTO temperature_samples (sensor, timestamp, seq, temperature) VALUES (?1, ?2, "
+    "(SELECT COALESCE(MAX(seq) + 1, 0) FROM temperature_samples WHERE sensor = ?1 AND timestamp = ?2), ?3);",
+
+    "INSERT INTO temperature_rollup (" ROLLUP_COLUMNS ") VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?) " ROLLUP_MERGE,
+
+    "SELECT timestamp, temperature, sensor FROM temperature_samples ORDER BY timestamp DESC LIMIT 1;",
+
+    "SELECT timestamp, temperature, sensor FROM temperature_samples "
+    "WHERE timestamp >= " RANGE_START " AND timestamp <= " RANGE_END " "
+    "ORDER BY timestamp ASC;",
+
+    "SELECT timestamp, temperature, sensor FROM temperature_samples "
+    "WHERE sensor = ?3 AND timestamp >= " RANGE_START " AND timestamp <= " RANGE_END " "
+    "ORDER BY timestamp ASC;",
+
+    "SELECT " ROLLUP_COLUMNS " FROM temperature_rollup "
+    "WHERE resolution = ?1 AND bucket_start >= ?2 AND bucket_start <= ?3 ORDER BY bucket_start ASC;",
+
+    "SELECT " ROLLUP_COLUMNS " FROM temperature_rollup "
+    "WHERE resolution = ?1 AND sensor = ?4 AND bucket_start >= ?2 AND bucket_start <= ?3 ORDER BY bucket_start ASC;",
+
+    "SELECT timestamp, temperature, sensor FROM ("
+    "SELECT timestamp, temperature, sensor FROM temperature_samples "
+    "UNION ALL SELECT timestamp, temperature, 0 FROM temperature_log) "
+    "ORDER BY timestamp DESC LIMIT 1;",
+
+    "SELECT timestamp, temperature, sensor FROM ("
+    "SELECT timestamp, temperature, sensor FROM temperature_samples "
+    "WHERE timestamp >= " RANGE_START " AND timestamp <= " RANGE_END " "
+    "UNION ALL SELECT timestamp, temperature, 0 FROM temperature_log "
+    "WHERE timestamp >= " RANGE_START " AND timestamp <= " RANGE_END ") "
+    "ORDER BY timestamp ASC;",
+
+    // Старые записи без датчика переносятся как датчик 0
+    "SELECT timestamp, temperature, sensor FROM ("
+    "SELECT timestamp, temperature, sensor FROM temperature_samples "
+    "WHERE sensor = ?3 AND timestamp >= " RANGE_START " AND timestamp <= " RANGE_END " "
+    "UNION ALL SELECT timestamp, temperature, 0 FROM temperature_log "
+    "WHERE ?3 = 0 AND timestamp >= " RANGE_START " AND timestamp <= " RANGE_END ") "
+    "ORDER BY timestamp ASC;"
+};
+
+#define STATEMENT_FIRST_READ STATEMENT_GET_LAST_TEMPERATURE
+
+static const long long rollupSeconds[DATABASE_ROLLUP_RESOLUTION_COUNT] = { 60, 3600, 86400 };
+
+// Агрегат одной корзины внутри пачки вставки, перед слиянием с таблицей
+typedef struct {
+    bool used;
+    int resolution;
+    int sensor;
+    long long bucketStart;
+    long long count;
+    double sum;
+    double min;
+    double max;
+    double mean;
+    double m2;
+} RollupSlot;
+
+// Месячный раздел temperature_samples_YYYYMM со строками [start, end), секунды UTC
+typedef struct {
+    char name[PARTITION_NAME_SIZE];
+    long long start;
+    long long end;
+} DatabasePartition;
+
+// Запрос к разделу; в статистике учитывается вместе с одноимённым запросом к архиву
+typedef struct {
+    long long partitionStart;
+    DatabaseStatement statement;
+    sqlite3_stmt *stmt;
+} PartitionStatement;
+
+typedef struct {
+    sqlite3 *db;
+    sqlite3_stmt *statements[STATEMENT_COUNT];
+    PartitionStatement *partitionStatements;
+    int partitionStatementCount;
+    int partitionStatementCapacity;
+    unsigned long long partitionEpoch;   // кэш выше действителен для этой эпохи списка разделов
+} DatabaseConnection;
+
+// Одно соединение для записи и пул соединений только для чтения: в WAL-режиме чтение
+// не ждёт записи и другого чтения. Запросы готовятся один раз при открытии соединения,
+// на каждый вызов только сбрасываются привязки.
+static struct {
+    char path[512];
+
+    DatabaseConnection writer;
+    pthread_mutex_t writerLock;        // одна транзакция записи за раз
+    RollupSlot *rollupSlots;           // агрегаты пачки, под writerLock
+    int rollupSlotCapacity;
+
+    DatabaseConnection readers[DATABASE_READ_CONNECTIONS];
+    bool readerBusy[DATABASE_READ_CONNECTIONS];
+    unsigned long long readerEpoch[DATABASE_READ_CONNECTIONS];
+    int migratingReaders;              // выданные соединения, читающие обе таблицы
+    pthread_mutex_t poolLock;
+    pthread_cond_t poolChanged;
+
+    DatabaseStatementStats stats[STATEMENT_COUNT];
+    pthread_mutex_t statsLock;
+    bool locksCreated;
+
+    // Разделы по возрастанию start. Строки до archiveEnd - записанные до разбиения - остаются
+    // в архиве temperature_samples; archiveEnd задаётся при обновлении схемы и больше не меняется
+    DatabasePartition *partitions;
+    int partitionCount;
+    int partitionCapacity;
+    long long archiveEnd;
+    long long retentionFloor;            // под writerLock и partitionLock; строки старше удалены и не пишутся
+    pthread_mutex_t partitionLock;
+    unsigned long long partitionEpoch;   // под poolLock; растёт перед удалением разделов
+
+    // Фоновый перенос temperature_log в temperature_samples
+    bool migrating;                    // под poolLock
+    volatile bool stopMigration;
+    bool migrationStarted;
+    pthread_t migrationThread;
+} context;
+
+static double monotonicMs() {
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (double)counter.QuadPart * 1000.0 / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1000.0 + (double)now.tv_nsec / 1e6;
+#endif
+}
+
+static bool prepareStatements(DatabaseConnection *connection, int first, int last) {
+    for (int i = first; i < last; i++) {
+        double started = monotonicMs();
+        if (sqlite3_prepare_v3(connection->db, statementSql[i], -1, SQLITE_PREPARE_PERSISTENT,
+                               &connection->statements[i], NULL) != SQLITE_OK) {
+            fprintf(stderr, "Ошибка подготовки запроса %s: %s\n", statementNames[i], sqlite3_errmsg(connection->db));
+            return false;
+        }
+        pthread_mutex_lock(&context.statsLock);
+        context.stats[i].name = statementNames[i];
+        context.stats[i].prepares++;
+        context.stats[i].prepare_ms += monotonicMs() - started;
+        pthread_mutex_unlock(&context.statsLock);
+    }
+    return true;
+}
+
+static bool openConnection(DatabaseConnection *connection, int flags) {
+    // Соединение всегда используется одним потоком за раз - собственный мьютекс SQLite не нужен
+    if (sqlite3_open_v2(context.path, &connection->db, flags | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Ошибка открытия БД: %s\n", sqlite3_errmsg(connection->db));
         return false;
     }
+    sqlite3_busy_timeout(connection->db, DATABASE_BUSY_TIMEOUT_MS);
+    return true;
+}
 
-    if (sqlite3_exec(db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Ошибка включения WAL-режима: %s\n", sqlite3_errmsg(db));
-        sqlite3_close(db);
+static void clearPartitionStatements(DatabaseConnection *connection) {
+    for (int i = 0; i < connection->partitionStatementCount; i++) {
+        sqlite3_finalize(connection->partitionStatements[i].stmt);
+    }
+    connection->partitionStatementCount = 0;
+}
+
+static void closeConnection(DatabaseConnection *connection) {
+    clearPartitionStatements(connection);
+    free(connection->partitionStatements);
+    connection->partitionStatements = NULL;
+    connection->partitionStatementCapacity = 0;
+
+    for (int i = 0; i < STATEMENT_COUNT; i++) {
+        sqlite3_finalize(connection->statements[i]);
+        connection->statements[i] = NULL;
+    }
+    sqlite3_close(connection->db);
+    connection->db = NULL;
+}
+
+// Выдаёт свободное соединение чтения, при необходимости ждёт его возврата.
+// migrating фиксируется на время выдачи: старая таблица не удаляется, пока её читают;
+// так же удаление разделов ждёт возврата соединений, выданных до него.
+static DatabaseConnection* acquireReader(bool *migrating) {
+    pthread_mutex_lock(&context.poolLock);
+    for (;;) {
+        for (int i = 0; i < DATABASE_READ_CONNECTIONS; i++) {
+            if (!context.readerBusy[i]) {
+                context.readerBusy[i] = true;
+                context.readerEpoch[i] = context.partitionEpoch;
+                if (context.readers[i].partitionEpoch != context.partitionEpoch) {
+                    // Среди закэшированных могут быть запросы к удалённым разделам
+                    clearPartitionStatements(&context.readers[i]);
+                    context.readers[i].partitionEpoch = context.partitionEpoch;
+                }
+                *migrating = context.migrating;
+                if (*migrating) {
+                    context.migratingReaders++;
+                }
+                pthread_mutex_unlock(&context.poolLock);
+                return &context.readers[i];
+            }
+        }
+        pthread_cond_wait(&context.poolChanged, &context.poolLock);
+    }
+}
+
+static void releaseReader(DatabaseConnection *connection, bool migrating) {
+    pthread_mutex_lock(&context.poolLock);
+    context.readerBusy[connection - context.readers] = false;
+    if (migrating) {
+        context.migratingReaders--;
+    }
+    pthread_cond_broadcast(&context.poolChanged);
+    pthread_mutex_unlock(&context.poolLock);
+}
+
+static void resetStatement(sqlite3_stmt *stmt, DatabaseStatement statement, double started) {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    pthread_mutex_lock(&context.statsLock);
+    context.stats[statement].executions++;
+    context.stats[statement].execute_ms += monotonicMs() - started;
+    pthread_mutex_unlock(&context.statsLock);
+}
+
+static void releaseStatement(DatabaseConnection *connection, DatabaseStatement statement, double started) {
+    resetStatement(connection->statements[statement], statement, started);
+}
+
+static bool executeStatement(DatabaseConnection *connection, DatabaseStatement statement) {
+    double started = monotonicMs();
+    bool success = sqlite3_step(connection->statements[statement]) == SQLITE_DONE;
+    releaseStatement(connection, statement, started);
+    return success;
+}
+
+static bool executeSql(sqlite3 *db, const char *sql, const char *what) {
+    char *error = NULL;
+    if (sqlite3_exec(db, sql, NULL, NULL, &error) != SQLITE_OK) {
+        fprintf(stderr, "Ошибка %s: %s\n", what, error ? error : sqlite3_errmsg(db));
+        sqlite3_free(error);
         return false;
     }
+    return true;
+}
 
-    const char *sql =
-        "CREATE TABLE IF NOT EXISTS temperature_log ("
-        "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-        "timestamp INTEGER DEFAULT (strftime('%s', 'now')), "
-        "temperature REAL NOT NULL);";
+static sqlite3_int64 querySingleInt(sqlite3 *db, const char *sql, sqlite3_int64 fallback) {
+    sqlite3_stmt *stmt;
+    sqlite3_int64 value = fallback;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        return fallback;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
+        value = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return value;
+}
 
-    return sqlite3_exec(db, sql, NULL, NULL, NULL) == SQLITE_OK;
+// Календарь UTC без localtime/timegm: дни от 1970-01-01
+static long long daysFromCivil(long long year, int month, int day) {
+    year -= month <= 2;
+    long long era = (year >= 0 ? year : year - 399) / 400;
+    long long yearOfEra = year - era * 400;
+    long long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
 }
 
-void database_close() {
-    sqlite3_close(db);
+static void monthOf(long long timestamp, int *year, int *month) {
+    long long days = (timestamp >= 0 ? timestamp : timestamp - 86399) / 86400 + 719468;
+    long long era = (days >= 0 ? days : days - 146096) / 146097;
+    long long dayOfEra = days - era * 146097;
+    long long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    long long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    long long shiftedMonth = (5 * dayOfYear + 2) / 153;
+    *month = (int)(shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9);
+    *year = (int)(yearOfEra + era * 400 + (*month <= 2));
+}
+
+long long database_date_to_epoch(const char *date) {
+    int year = 1970, month = 1, day = 1;
+    sscanf(date, "%d-%d-%d", &year, &month, &day);
+    return daysFromCivil(year, month, day) * 86400;
+}
+
+
+// Менеджер разделов: вставки попадают в раздел своего месяца, выборки обходят только
+// пересекающиеся разделы, хранение ограничивается удалением целых разделов (DROP TABLE
+// без DELETE по миллионам строк, без разрастания WAL и блокировки чтения).
+
+static const char* partitionSqlTemplate(DatabaseStatement statement) {
+    switch (statement) {
+        case STATEMENT_INSERT_TEMPERATURE:
+            return "INSERT INTO %s (sensor, timestamp, seq, temperature) VALUES (?1, ?2, "
+                   "(SELECT COALESCE(MAX(seq) + 1, 0) FROM %s WHERE sensor = ?1 AND timestamp = ?2), ?3);";
+        case STATEMENT_GET_LAST_TEMPERATURE:
+            return "SELECT timestamp, temperature, sensor FROM %s ORDER BY timestamp DESC LIMIT 1;";
+        case STATEMENT_GET_TEMPERATURES:
+            return "SELECT timestamp, temperature, sensor FROM %s "
+                   "WHERE timestamp >= strftime('%%s', ?1 || ' 00:00:00') "
+                   "AND timestamp <= strftime('%%s', ?2 || ' 23:59:59') ORDER BY timestamp ASC;";
+        case STATEMENT_GET_SENSOR_TEMPERATURES:
+            return "SELECT timestamp, temperature, sensor FROM %s "
+                   "WHERE sensor = ?3 AND timestamp >= strftime('%%s', ?1 || ' 00:00:00') "
+                   "AND timestamp <= strftime('%%s', ?2 || ' 23:59:59') ORDER BY timestamp ASC;";
+        default:
+            return NULL;
+    }
 }
 
-bool database_insert_temperature(double temperature) {
-    const char *sql = "INSERT INTO temperature_log (temperature) VALUES (?);";
+// Запрос statement к разделу из кэша соединения; готовится при первом обращении
+static sqlite3_stmt* partitionStatement(DatabaseConnection *connection, const DatabasePartition *partition,
+                                        DatabaseStatement statement) {
+    for (int i = 0; i < connection->partitionStatementCount; i++) {
+        PartitionStatement *cached = &connection->partitionStatements[i];
+        if (cached->partitionStart == partition->start && cached->statement == statement) {
+            return cached->stmt;
+        }
+    }
+
+    if (connection->partitionStatementCount == connection->partitionStatementCapacity) {
+        int capacity = connection->partitionStatementCapacity ? connection->partitionStatementCapacity * 2 : 16;
+        PartitionStatement *grown = realloc(connection->partitionStatements, capacity * sizeof(PartitionStatement));
+        if (!grown) {
+            return NULL;
+        }
+        connection->partitionStatements = grown;
+        connection->partitionStatementCapacity = capacity;
+    }
+
+    char sql[512];
+    // В шаблоне имя таблицы встречается до двух раз
+    snprintf(sql, sizeof(sql), partitionSqlTemplate(statement), partition->name, partition->name);
+
+    double started = monotonicMs();
     sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v3(connection->db, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Ошибка подготовки запроса к разделу %s: %s\n", partition->name, sqlite3_errmsg(connection->db));
+        return NULL;
+    }
+    pthread_mutex_lock(&context.statsLock);
+    context.stats[statement].prepares++;
+    context.stats[statement].prepare_ms += monotonicMs() - started;
+    pthread_mutex_unlock(&context.statsLock);
+
+    connection->partitionStatements[connection->partitionStatementCount++] =
+        (PartitionStatement){ partition->start, statement, stmt };
+    return stmt;
+}
+
+// Индекс раздела со строкой timestamp или -1. Под partitionLock
+static int findPartitionLocked(long long timestamp) {
+    for (int i = context.partitionCount - 1; i >= 0; i--) {
+        if (timestamp >= context.partitions[i].start && timestamp < context.partitions[i].end) {
+            return i;
+        }
+        if (timestamp >= context.partitions[i].end) {
+            break;
+        }
+    }
+    return -1;
+}
 
-    if (sqlite3_exec(db, "BEGIN TRANSACTION;", NULL, NULL, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Ошибка начала транзакции: %s\n", sqlite3_errmsg(db));
+static bool addPartitionLocked(const DatabasePartition *partition) {
+    if (context.partitionCount == context.partitionCapacity) {
+        int capacity = context.partitionCapacity ? context.partitionCapacity * 2 : 16;
+        DatabasePartition *grown = realloc(context.partitions, capacity * sizeof(DatabasePartition));
+        if (!grown) {
+            return false;
+        }
+        context.partitions = grown;
+        context.partitionCapacity = capacity;
+    }
+
+    int index = context.partitionCount;
+    while (index > 0 && context.partitions[index - 1].start > partition->start) {
+        index--;
+    }
+    memmove(&context.partitions[index + 1], &context.partitions[index],
+            (context.partitionCount - index) * sizeof(DatabasePartition));
+    context.partitions[index] = *partition;
+    context.partitionCount++;
+    return true;
+}
+
+// Раздел месяца timestamp, при первой записи в месяц создаётся. Под writerLock, вне транзакции
+static bool ensurePartition(long long timestamp, DatabasePartition *partition) {
+    pthread_mutex_lock(&context.partitionLock);
+    if (timestamp < context.retentionFloor) {
+        // Месяц уже удалён или удаляется - таблицу нельзя создавать заново
+        pthread_mutex_unlock(&context.partitionLock);
         return false;
     }
+    int index = findPartitionLocked(timestamp);
+    if (index >= 0) {
+        *partition = context.partitions[index];
+    }
+    pthread_mutex_unlock(&context.partitionLock);
+    if (index >= 0) {
+        return true;
+    }
 
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Ошибка выполнения транзакции: %s\n", sqlite3_errmsg(db));
-        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+    int year, month;
+    monthOf(timestamp, &year, &month);
+    snprintf(partition->name, sizeof(partition->name), ARCHIVE_TABLE "_%04d%02d", year, month);
+    partition->start = daysFromCivil(year, month, 1) * 86400;
+    partition->end = (month == 12 ? daysFromCivil(year + 1, 1, 1) : daysFromCivil(year, month + 1, 1)) * 86400;
+    if (partition->start < context.archiveEnd) {
+        partition->start = context.archiveEnd;
+    }
+
+    char sql[1024];
+    snprintf(sql, sizeof(sql),
+        "BEGIN IMMEDIATE TRANSACTION;"
+        "CREATE TABLE IF NOT EXISTS %s (" SAMPLES_COLUMNS ") WITHOUT ROWID;"
+        "CREATE INDEX IF NOT EXISTS %s_timestamp ON %s (timestamp, temperature);"
+        "INSERT OR REPLACE INTO temperature_partitions (name, range_start, range_end) VALUES ('%s', %lld, %lld);"
+        "COMMIT;",
+        partition->name, partition->name, partition->name, partition->name, partition->start, partition->end);
+    if (!executeSql(context.writer.db, sql, "создания раздела")) {
+        executeSql(context.writer.db, "ROLLBACK;", "отката создания раздела");
         return false;
     }
 
-    sqlite3_bind_double(stmt, 1, temperature);
-    bool success = sqlite3_step(stmt) == SQLITE_DONE;
+    pthread_mutex_lock(&context.partitionLock);
+    bool added = addPartitionLocked(partition);
+    pthread_mutex_unlock(&context.partitionLock);
+    return added;
+}
+
+static void removePartitionLocked(const char *name) {
+    for (int i = 0; i < context.partitionCount; i++) {
+        if (strcmp(context.partitions[i].name, name) == 0) {
+            memmove(&context.partitions[i], &context.partitions[i + 1],
+                    (context.partitionCount - i - 1) * sizeof(DatabasePartition));
+            context.partitionCount--;
+            return;
+        }
+    }
+}
+
+// Копия разделов, пересекающих [from, to]; освобождает вызывающий
+static DatabasePartition* snapshotPartitions(long long from, long long to, int *count) {
+    pthread_mutex_lock(&context.partitionLock);
+    DatabasePartition *snapshot = malloc((context.partitionCount ? context.partitionCount : 1) * sizeof(DatabasePartition));
+    *count = 0;
+    for (int i = 0; snapshot && i < context.partitionCount; i++) {
+        if (context.partitions[i].start <= to && context.partitions[i].end > from) {
+            snapshot[(*count)++] = context.partitions[i];
+        }
+    }
+    pthread_mutex_unlock(&context.partitionLock);
+    return snapshot;
+}
+
+static bool loadPartitions() {
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(context.writer.db,
+            "SELECT name, range_start, range_end FROM temperature_partitions ORDER BY range_start;",
+            -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Ошибка чтения списка разделов: %s\n", sqlite3_errmsg(context.writer.db));
+        return false;
+    }
+
+    bool success = true;
+    while (success && sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *name = (const char *)sqlite3_column_text(stmt, 0);
+        if (strcmp(name, ARCHIVE_TABLE) == 0) {
+            context.archiveEnd = sqlite3_column_int64(stmt, 2);
+            continue;
+        }
+        DatabasePartition partition;
+        snprintf(partition.name, sizeof(partition.name), "%s", name);
+        partition.start = sqlite3_column_int64(stmt, 1);
+        partition.end = sqlite3_column_int64(stmt, 2);
+        success = addPartitionLocked(&partition);
+    }
     sqlite3_finalize(stmt);
+    return success;
+}
 
-    if (success) {
-        if (sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK) {
-            fprintf(stderr, "Ошибка завершения транзакции: %s\n", sqlite3_errmsg(db));
+// Ждёт возврата соединений чтения, выданных до этого вызова: они могли взять старый список разделов
+static void waitForEarlierReaders() {
+    pthread_mutex_lock(&context.poolLock);
+    unsigned long long epoch = ++context.partitionEpoch;
+    for (;;) {
+        bool busy = false;
+        for (int i = 0; i < DATABASE_READ_CONNECTIONS; i++) {
+            busy |= context.readerBusy[i] && context.readerEpoch[i] < epoch;
+        }
+        if (!busy) {
+            break;
+        }
+        pthread_cond_wait(&context.poolChanged, &context.poolLock);
+    }
+    pthread_mutex_unlock(&context.poolLock);
+}
+
+int database_drop_partitions_before(long long cutoff) {
+    // Сначала разделы пропадают из списка для новых запросов, а вставка перестаёт принимать
+    // строки старше последнего из них: иначе пачка старых строк, пришедшая до DROP, заново
+    // создала бы раздел и потеряла строки вместе с ним. Под writerLock - чтобы пачка
+    // не потеряла раздел между его созданием и вставкой
+    pthread_mutex_lock(&context.writerLock);
+
+    // Архив целиком старше cutoff заменяется пустым, пока в него не идёт перенос temperature_log
+    pthread_mutex_lock(&context.poolLock);
+    bool dropArchive = context.archiveEnd > 0 && context.archiveEnd <= cutoff && !context.migrating;
+    pthread_mutex_unlock(&context.poolLock);
+    dropArchive = dropArchive &&
+                  querySingleInt(context.writer.db, "SELECT EXISTS (SELECT 1 FROM " ARCHIVE_TABLE ");", 0);
+
+    pthread_mutex_lock(&context.partitionLock);
+    int count = 0;
+    while (count < context.partitionCount && context.partitions[count].end <= cutoff) {
+        count++;
+    }
+    DatabasePartition *expired = malloc((count ? count : 1) * sizeof(DatabasePartition));
+    if (!expired) {
+        pthread_mutex_unlock(&context.partitionLock);
+        pthread_mutex_unlock(&context.writerLock);
+        return -1;
+    }
+    memcpy(expired, context.partitions, count * sizeof(DatabasePartition));
+    memmove(context.partitions, context.partitions + count, (context.partitionCount - count) * sizeof(DatabasePartition));
+    context.partitionCount -= count;
+    if (count > 0 && expired[count - 1].end > context.retentionFloor) {
+        context.retentionFloor = expired[count - 1].end;
+    }
+    if (dropArchive && context.archiveEnd > context.retentionFloor) {
+        context.retentionFloor = context.archiveEnd;
+    }
+    pthread_mutex_unlock(&context.partitionLock);
+    pthread_mutex_unlock(&context.writerLock);
+
+    if (count == 0 && !dropArchive) {
+        free(expired);
+        return 0;
+    }
+    waitForEarlierReaders();
+
+    pthread_mutex_lock(&context.writerLock);
+    clearPartitionStatements(&context.writer);
+
+    int dropped = 0;
+    for (int i = 0; i < count; i++) {
+        char sql[256];
+        snprintf(sql, sizeof(sql),
+            "BEGIN IMMEDIATE TRANSACTION; DROP TABLE IF EXISTS %s; "
+            "DELETE FROM temperature_partitions WHERE name = '%s'; COMMIT;", expired[i].name, expired[i].name);
+        bool success = executeSql(context.writer.db, sql, "удаления раздела");
+        if (!success) {
+            executeSql(context.writer.db, "ROLLBACK;", "отката удаления раздела");
+        }
+
+        // Удалённый раздел не должен остаться в списке, неудалённый возвращается до следующего прохода
+        pthread_mutex_lock(&context.partitionLock);
+        removePartitionLocked(expired[i].name);
+        if (!success) {
+            addPartitionLocked(&expired[i]);
+        }
+        pthread_mutex_unlock(&context.partitionLock);
+
+        if (success) {
+            printf("БД: удалён раздел %s\n", expired[i].name);
+            dropped++;
+        }
+    }
+    if (dropArchive) {
+        if (executeSql(context.writer.db,
+                "BEGIN IMMEDIATE TRANSACTION; DROP TABLE " ARCHIVE_TABLE ";"
+                "CREATE TABLE " ARCHIVE_TABLE " (" SAMPLES_COLUMNS ") WITHOUT ROWID;"
+                "CREATE INDEX " ARCHIVE_TABLE "_timestamp ON " ARCHIVE_TABLE " (timestamp, temperature); COMMIT;",
+                "очистки архива")) {
+            printf("БД: очищен архив " ARCHIVE_TABLE "\n");
+            dropped++;
+        } else {
+            executeSql(context.writer.db, "ROLLBACK;", "отката очистки архива");
+        }
+    }
+
+    pthread_mutex_unlock(&context.writerLock);
+    free(expired);
+    return dropped;
+}
+
+// Агрегаты строк источника по корзинам одного разрешения со слиянием в temperature_rollup.
+// Корзины выровнены по UTC, как и границы дат в запросах за период.
+static void buildRollupSql(char *sql, size_t size, int resolution, const char *sensor, const char *source) {
+    long long width = rollupSeconds[resolution];
+    snprintf(sql, size,
+        "INSERT INTO temperature_rollup (" ROLLUP_COLUMNS ") "
+        "SELECT %d, %s, timestamp / %lld * %lld, timestamp / %lld * %lld + %lld, COUNT(*), SUM(temperature), "
+        "MIN(temperature), MAX(temperature), AVG(temperature), "
+        "MAX(0, SUM(temperature * temperature) - SUM(temperature) * SUM(temperature) / COUNT(*)) "
+        "%s GROUP BY 2, 3 " ROLLUP_MERGE,
+        resolution, sensor, width, width, width, width, width, source);
+}
+
+// Переносит строки temperature_log порциями по id в отдельном соединении. Каждая порция
+// вставляется и удаляется из старой таблицы в одной транзакции, поэтому строка всегда
+// находится ровно в одной из таблиц и объединённое чтение не видит дублей.
+// Старые строки получают датчик 0 и отрицательный seq = -id, чтобы не пересечься с новыми.
+static void *migrateLegacyTable(void *arg) {
+    (void)arg;
+    sqlite3 *db = NULL;
+    sqlite3_stmt *move = NULL, *remove = NULL;
+    sqlite3_stmt *rollups[DATABASE_ROLLUP_RESOLUTION_COUNT] = { NULL };
+    unsigned long long moved = 0;
+
+    if (sqlite3_open(context.path, &db) != SQLITE_OK) {
+        fprintf(stderr, "Ошибка открытия БД для переноса: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return NULL;
+    }
+    sqlite3_busy_timeout(db, DATABASE_BUSY_TIMEOUT_MS);
+
+    if (sqlite3_prepare_v2(db,
+            "INSERT INTO temperature_samples (sensor, timestamp, seq, temperature) "
+            "SELECT 0, timestamp, -id, temperature FROM temperature_log WHERE id >= ?1 AND id < ?2;",
+            -1, &move, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(db, "DELETE FROM temperature_log WHERE id >= ?1 AND id < ?2;",
+            -1, &remove, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Ошибка подготовки переноса: %s\n", sqlite3_errmsg(db));
+        goto done;
+    }
+    for (int i = 0; i < DATABASE_ROLLUP_RESOLUTION_COUNT; i++) {
+        char sql[1024];
+        buildRollupSql(sql, sizeof(sql), i, "0", "FROM temperature_log WHERE id >= ?1 AND id < ?2");
+        if (sqlite3_prepare_v2(db, sql, -1, &rollups[i], NULL) != SQLITE_OK) {
+            fprintf(stderr, "Ошибка подготовки переноса: %s\n", sqlite3_errmsg(db));
+            goto done;
+        }
+    }
+
+    while (!context.stopMigration) {
+        sqlite3_int64 first = querySingleInt(db, "SELECT MIN(id) FROM temperature_log;", -1);
+        if (first < 0) {
+            break;
+        }
+        sqlite3_int64 last = first + MIGRATION_CHUNK_ROWS;
+
+        if (!executeSql(db, "BEGIN IMMEDIATE TRANSACTION;", "начала переноса")) {
+            SleepMs(MIGRATION_PAUSE_MS);
+            continue;
+        }
+        sqlite3_bind_int64(move, 1, first);
+        sqlite3_bind_int64(move, 2, last);
+        sqlite3_bind_int64(remove, 1, first);
+        sqlite3_bind_int64(remove, 2, last);
+
+        // Агрегаты порции считаются в той же транзакции, до удаления строк
+        bool success = true;
+        for (int i = 0; i < DATABASE_ROLLUP_RESOLUTION_COUNT && success; i++) {
+            sqlite3_bind_int64(rollups[i], 1, first);
+            sqlite3_bind_int64(rollups[i], 2, last);
+            success = sqlite3_step(rollups[i]) == SQLITE_DONE;
+            sqlite3_reset(rollups[i]);
+        }
+        success = success && sqlite3_step(move) == SQLITE_DONE && sqlite3_step(remove) == SQLITE_DONE;
+        if (success) {
+            moved += sqlite3_changes(db);
+        }
+        sqlite3_reset(move);
+        sqlite3_reset(remove);
+
+        if (!success || !executeSql(db, "COMMIT;", "завершения переноса")) {
+            fprintf(stderr, "Ошибка переноса старых записей: %s\n", sqlite3_errmsg(db));
+            executeSql(db, "ROLLBACK;", "отката переноса");
+            goto done;
+        }
+        SleepMs(MIGRATION_PAUSE_MS);
+    }
+
+    if (!context.stopMigration) {
+        // Новые запросы читают только новую таблицу; старая удаляется, когда вернутся
+        // соединения, выданные до переключения
+        pthread_mutex_lock(&context.poolLock);
+        context.migrating = false;
+        while (context.migratingReaders > 0) {
+            pthread_cond_wait(&context.poolChanged, &context.poolLock);
+        }
+        pthread_mutex_unlock(&context.poolLock);
+
+        char sql[64];
+        snprintf(sql, sizeof(sql), "PRAGMA user_version = %d;", DATABASE_SCHEMA_VERSION);
+        if (executeSql(db, "DROP TABLE temperature_log;", "удаления старой таблицы") &&
+            executeSql(db, sql, "обновления версии схемы")) {
+            printf("БД: перенесено %llu старых записей, схема версии %d\n", moved, DATABASE_SCHEMA_VERSION);
+        }
+    }
+
+done:
+    for (int i = 0; i < DATABASE_ROLLUP_RESOLUTION_COUNT; i++) {
+        sqlite3_finalize(rollups[i]);
+    }
+    sqlite3_finalize(move);
+    sqlite3_finalize(remove);
+    sqlite3_close(db);
+    return NULL;
+}
+
+// Версия 1 - temperature_log с rowid и без индексов: выборка за период читала всю таблицу.
+// Версия 2 - temperature_samples без rowid, упорядоченная по (sensor, timestamp), и покрывающий
+// индекс по timestamp: выборка за период - поиск по дереву и последовательное чтение.
+// Версия 3 - агрегаты по минутам, часам и суткам обновляются в транзакции вставки.
+// Версия 4 - новые строки в месячных разделах, temperature_samples - архив строк до перехода.
+static bool rebuildRollups(sqlite3 *db);
+
+static bool upgradeSchema() {
+    const char *sql =
+        "CREATE TABLE IF NOT EXISTS " ARCHIVE_TABLE " (" SAMPLES_COLUMNS ") WITHOUT ROWID;"
+        "CREATE INDEX IF NOT EXISTS " ARCHIVE_TABLE "_timestamp "
+        "ON " ARCHIVE_TABLE " (timestamp, temperature);"
+        "CREATE TABLE IF NOT EXISTS temperature_partitions ("
+        "name TEXT PRIMARY KEY, "
+        "range_start INTEGER NOT NULL, "
+        "range_end INTEGER NOT NULL);"
+        "CREATE TABLE IF NOT EXISTS temperature_rollup ("
+        "resolution INTEGER NOT NULL, "
+        "sensor INTEGER NOT NULL, "
+        "bucket_start INTEGER NOT NULL, "
+        "bucket_end INTEGER NOT NULL, "
+        "count INTEGER NOT NULL, "
+        "sum REAL NOT NULL, "
+        "min REAL NOT NULL, "
+        "max REAL NOT NULL, "
+        "mean REAL NOT NULL, "
+        "m2 REAL NOT NULL, "
+        "PRIMARY KEY (resolution, sensor, bucket_start)) WITHOUT ROWID;"
+        "CREATE INDEX IF NOT EXISTS temperature_rollup_time "
+        "ON temperature_rollup (resolution, bucket_start);";
+
+    sqlite3 *db = context.writer.db;
+    if (!executeSql(db, sql, "создания таблиц")) {
+        return false;
+    }
+
+    sqlite3_int64 version = querySingleInt(db, "PRAGMA user_version;", 0);
+    if (version >= DATABASE_SCHEMA_VERSION) {
+        return true;
+    }
+
+    if (version < 3 && !rebuildRollups(db)) {
+        return false;
+    }
+
+    // Уже записанное остаётся в архиве, новые строки идут в месячные разделы
+    bool legacy = querySingleInt(db,
+        "SELECT COUNT(*) FROM sqlite_master WHERE type = 'table' AND name = 'temperature_log';", 0) > 0;
+    sqlite3_int64 last = querySingleInt(db, "SELECT MAX(timestamp) FROM " ARCHIVE_TABLE ";", -1);
+    if (legacy) {
+        sqlite3_int64 lastLegacy = querySingleInt(db, "SELECT MAX(timestamp) FROM temperature_log;", -1);
+        last = (lastLegacy > last) ? lastLegacy : last;
+    }
+    char archive[192];
+    snprintf(archive, sizeof(archive),
+             "INSERT OR IGNORE INTO temperature_partitions (name, range_start, range_end) "
+             "VALUES ('" ARCHIVE_TABLE "', 0, %lld);", (long long)(last + 1));
+    if (!executeSql(db, archive, "регистрации архива")) {
+        return false;
+    }
+
+    context.migrating = legacy;
+    if (context.migrating) {
+        return true;
+    }
+
+    char versionSql[64];
+    snprintf(versionSql, sizeof(versionSql), "PRAGMA user_version = %d;", DATABASE_SCHEMA_VERSION);
+    return executeSql(db, versionSql, "обновления версии схемы");
+}
+
+// Прежние агрегаты писал логгер со своими границами корзин - пересчитываются из отсчётов
+static bool rebuildRollups(sqlite3 *db) {
+    bool rebuilt = executeSql(db, "BEGIN IMMEDIATE TRANSACTION; DELETE FROM temperature_rollup;", "пересчёта агрегатов");
+    for (int i = 0; i < DATABASE_ROLLUP_RESOLUTION_COUNT && rebuilt; i++) {
+        char rollupSql[1024];
+        buildRollupSql(rollupSql, sizeof(rollupSql), i, "sensor", "FROM temperature_samples WHERE 1");
+        rebuilt = executeSql(db, rollupSql, "пересчёта агрегатов");
+    }
+    if (!rebuilt || !executeSql(db, "COMMIT;", "пересчёта агрегатов")) {
+        executeSql(db, "ROLLBACK;", "отката пересчёта агрегатов");
+        return false;
+    }
+    return true;
+}
+
+bool database_init(const char *db_path) {
+    memset(&context, 0, sizeof(context));
+    snprintf(context.path, sizeof(context.path), "%s", db_path);
+    pthread_mutex_init(&context.writerLock, NULL);
+    pthread_mutex_init(&context.poolLock, NULL);
+    pthread_cond_init(&context.poolChanged, NULL);
+    pthread_mutex_init(&context.statsLock, NULL);
+    pthread_mutex_init(&context.partitionLock, NULL);
+    context.locksCreated = true;
+
+    if (!openConnection(&context.writer, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE)) {
+        database_close();
+        return false;
+    }
+
+    if (sqlite3_exec(context.writer.db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Ошибка включения WAL-режима: %s\n", sqlite3_errmsg(context.writer.db));
+        database_close();
+        return false;
+    }
+
+    if (!upgradeSchema() || !loadPartitions() || !prepareStatements(&context.writer, 0, STATEMENT_FIRST_READ)) {
+        database_close();
+        return false;
+    }
+
+    // Запросы к старой таблице готовятся, только пока она существует
+    int lastRead = context.migrating ? STATEMENT_COUNT : STATEMENT_FIRST_MIGRATING;
+    for (int i = 0; i < DATABASE_READ_CONNECTIONS; i++) {
+        if (!openConnection(&context.readers[i], SQLITE_OPEN_READONLY) ||
+            !prepareStatements(&context.readers[i], STATEMENT_FIRST_READ, lastRead)) {
+            database_close();
             return false;
         }
-    } else {
-        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
     }
 
+    if (context.migrating) {
+        if (pthread_create(&context.migrationThread, NULL, migrateLegacyTable, NULL) != 0) {
+            fprintf(stderr, "Ошибка: не удалось запустить перенос старых записей\n");
+            database_close();
+            return false;
+        }
+        context.migrationStarted = true;
+    }
+    return true;
+}
+
+void database_close() {
+    if (context.migrationStarted) {
+        // Прерванный перенос продолжится со следующей порции при следующем запуске
+        context.stopMigration = true;
+        pthread_join(context.migrationThread, NULL);
+        context.migrationStarted = false;
+    }
+
+    for (int i = 0; i < DATABASE_READ_CONNECTIONS; i++) {
+        closeConnection(&context.readers[i]);
+    }
+    closeConnection(&context.writer);
+    free(context.rollupSlots);
+    context.rollupSlots = NULL;
+    context.rollupSlotCapacity = 0;
+    free(context.partitions);
+    context.partitions = NULL;
+    context.partitionCount = 0;
+    context.partitionCapacity = 0;
+
+    if (context.locksCreated) {
+        pthread_mutex_destroy(&context.writerLock);
+        pthread_mutex_destroy(&context.poolLock);
+        pthread_cond_destroy(&context.poolChanged);
+        pthread_mutex_destroy(&context.statsLock);
+        pthread_mutex_destroy(&context.partitionLock);
+        context.locksCreated = false;
+    }
+}
+
+int database_get_statement_stats(DatabaseStatementStats *stats, int max) {
+    int count = (max < STATEMENT_COUNT) ? max : STATEMENT_COUNT;
+
+    pthread_mutex_lock(&context.statsLock);
+    memcpy(stats, context.stats, count * sizeof(DatabaseStatementStats));
+    pthread_mutex_unlock(&context.statsLock);
+    return count;
+}
+
+void database_print_stats() {
+    DatabaseStatementStats stats[STATEMENT_COUNT];
+    int count = database_get_statement_stats(stats, STATEMENT_COUNT);
+
+    for (int i = 0; i < count; i++) {
+        printf("Запрос %s: подготовок %llu (%.3f мс), выполнений %llu (%.3f мс)\n",
+               stats[i].name ? stats[i].name : "-", stats[i].prepares, stats[i].prepare_ms,
+               stats[i].executions, stats[i].execute_ms);
+    }
+}
+
+static unsigned int rollupSlotHash(int resolution, int sensor, long long bucketStart) {
+    unsigned long long key = ((unsigned long long)bucketStart * 31 + (unsigned int)sensor) * 4 + resolution;
+    key *= 0x9E3779B97F4A7C15ULL;
+    return (unsigned int)(key >> 32);
+}
+
+// Сводит пачку в агрегаты по (разрешение, датчик, корзина) в открытой адресации: на пачку
+// из тысяч отсчётов приходится по нескольку строк агрегатов, а не по три upsert на отсчёт
+static int accumulateRollups(const TemperatureRecord *records, int count) {
+    int capacity = 64;
+    while (capacity < count * DATABASE_ROLLUP_RESOLUTION_COUNT * 2) {
+        capacity *= 2;
+    }
+    if (capacity > context.rollupSlotCapacity) {
+        RollupSlot *slots = realloc(context.rollupSlots, capacity * sizeof(RollupSlot));
+        if (!slots) {
+            return -1;
+        }
+        context.rollupSlots = slots;
+        context.rollupSlotCapacity = capacity;
+    }
+    memset(context.rollupSlots, 0, capacity * sizeof(RollupSlot));
+
+    for (int i = 0; i < count; i++) {
+        for (int resolution = 0; resolution < DATABASE_ROLLUP_RESOLUTION_COUNT; resolution++) {
+            long long bucketStart = records[i].timestamp / rollupSeconds[resolution] * rollupSeconds[resolution];
+            unsigned int index = rollupSlotHash(resolution, records[i].sensor, bucketStart) & (capacity - 1);
+
+            RollupSlot *slot = &context.rollupSlots[index];
+            while (slot->used && (slot->resolution != resolution || slot->sensor != records[i].sensor ||
+                                  slot->bucketStart != bucketStart)) {
+                index = (index + 1) & (capacity - 1);
+                slot = &context.rollupSlots[index];
+            }
+            if (!slot->used) {
+                slot->used = true;
+                slot->resolution = resolution;
+                slot->sensor = records[i].sensor;
+                slot->bucketStart = bucketStart;
+                slot->min = slot->max = records[i].temperature;
+            }
+
+            // Уэлфорд, как в RollupAccumulator логгера
+            double value = records[i].temperature;
+            double delta = value - slot->mean;
+            slot->count++;
+            slot->sum += value;
+            slot->mean += delta / slot->count;
+            slot->m2 += delta * (value - slot->mean);
+            if (value < slot->min) slot->min = value;
+            if (value > slot->max) slot->max = value;
+        }
+    }
+    return capacity;
+}
+
+static bool upsertRollups(DatabaseConnection *writer, const TemperatureRecord *records, int count) {
+    int capacity = accumulateRollups(records, count);
+    if (capacity < 0) {
+        fprintf(stderr, "Ошибка: не хватает памяти для агрегатов\n");
+        return false;
+    }
+
+    double started = monotonicMs();
+    sqlite3_stmt *stmt = writer->statements[STATEMENT_INSERT_ROLLUP];
+    bool success = true;
+    for (int i = 0; i < capacity && success; i++) {
+        const RollupSlot *slot = &context.rollupSlots[i];
+        if (!slot->used) {
+            continue;
+        }
+        sqlite3_bind_int(stmt, 1, slot->resolution);
+        sqlite3_bind_int(stmt, 2, slot->sensor);
+        sqlite3_bind_int64(stmt, 3, slot->bucketStart);
+        sqlite3_bind_int64(stmt, 4, slot->bucketStart + rollupSeconds[slot->resolution]);
+        sqlite3_bind_int64(stmt, 5, slot->count);
+        sqlite3_bind_double(stmt, 6, slot->sum);
+        sqlite3_bind_double(stmt, 7, slot->min);
+        sqlite3_bind_double(stmt, 8, slot->max);
+        sqlite3_bind_double(stmt, 9, slot->mean);
+        sqlite3_bind_double(stmt, 10, slot->m2);
+        success = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+    }
+    if (!success) {
+        fprintf(stderr, "Ошибка записи агрегата: %s\n", sqlite3_errmsg(writer->db));
+    }
+    releaseStatement(writer, STATEMENT_INSERT_ROLLUP, started);
     return success;
 }
 
-TemperatureRecord* database_get_last_temperature(int *count) {
-    const char *sql = "SELECT timestamp, temperature FROM temperature_log ORDER BY id DESC LIMIT 1;";
-    sqlite3_stmt *stmt;
-    TemperatureRecord *record = NULL;
-    *count = 0;
+bool database_insert_temperature(int sensor, double temperature) {
+    TemperatureRecord record = { .timestamp = (int)time(NULL), .temperature = temperature, .sensor = sensor };
+    return database_insert_temperatures(&record, 1);
+}
+
+bool database_insert_temperatures(const TemperatureRecord *records, int count) {
+    if (count <= 0) return true;
+
+    // Соединение записи занято на всю транзакцию
+    DatabaseConnection *writer = &context.writer;
+    pthread_mutex_lock(&context.writerLock);
+
+    // Строки старше срока хранения не пишутся: их раздел уже удалён или удаляется.
+    // В агрегаты они попадают - агрегаты переживают удаление разделов
+    pthread_mutex_lock(&context.partitionLock);
+    long long retentionFloor = context.retentionFloor;
+    pthread_mutex_unlock(&context.partitionLock);
+
+    // Разделы создаются до транзакции пачки, чтобы её откат не оставил в списке раздел без таблицы
+    DatabasePartition partition = { .start = LLONG_MAX, .end = LLONG_MIN };
+    for (int i = 0; i < count; i++) {
+        long long timestamp = records[i].timestamp;
+        if (timestamp >= retentionFloor && timestamp >= context.archiveEnd && (timestamp < partition.start || timestamp >= partition.end) &&
+            !ensurePartition(timestamp, &partition)) {
+            pthread_mutex_unlock(&context.writerLock);
+            return false;
+        }
+    }
+
+    if (!executeStatement(writer, STATEMENT_BEGIN)) {
+        fprintf(stderr, "Ошибка начала транзакции: %s\n", sqlite3_errmsg(writer->db));
+        pthread_mutex_unlock(&context.writerLock);
+        return false;
+    }
 
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK) {
-        if (sqlite3_step(stmt) == SQLITE_ROW) {
-            record = malloc(sizeof(TemperatureRecord));
-            if (record) {
-                record->timestamp = sqlite3_column_int(stmt, 0);
-                record->temperature = sqlite3_column_double(stmt, 1);
-                *count = 1;
+    double started = monotonicMs();
+    sqlite3_stmt *archiveStmt = writer->statements[STATEMENT_INSERT_TEMPERATURE];
+    sqlite3_stmt *partitionStmt = NULL;
+    partition.start = LLONG_MAX;
+    partition.end = LLONG_MIN;
+    bool success = true;
+    int expired = 0;
+    for (int i = 0; i < count && success; i++) {
+        long long timestamp = records[i].timestamp;
+        if (timestamp < retentionFloor) {
+            expired++;
+            continue;
+        }
+        sqlite3_stmt *stmt = archiveStmt;
+        if (timestamp >= context.archiveEnd) {
+            if (timestamp < partition.start || timestamp >= partition.end) {
+                pthread_mutex_lock(&context.partitionLock);
+                int index = findPartitionLocked(timestamp);
+                if (index >= 0) {
+                    partition = context.partitions[index];
+                }
+                pthread_mutex_unlock(&context.partitionLock);
+                partitionStmt = (index >= 0) ? partitionStatement(writer, &partition, STATEMENT_INSERT_TEMPERATURE) : NULL;
+            }
+            if (!partitionStmt) {
+                success = false;
+                break;
             }
+            stmt = partitionStmt;
         }
+
+        sqlite3_bind_int(stmt, 1, records[i].sensor);
+        sqlite3_bind_int(stmt, 2, records[i].timestamp);
+        sqlite3_bind_double(stmt, 3, records[i].temperature);
+        success = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
     }
-    sqlite3_finalize(stmt);
-    return record;
+    if (!success) {
+        fprintf(stderr, "Ошибка вставки: %s\n", sqlite3_errmsg(writer->db));
+    } else if (expired > 0) {
+        fprintf(stderr, "БД: %d отсчётов старше срока хранения не записаны\n", expired);
+    }
+    releaseStatement(writer, STATEMENT_INSERT_TEMPERATURE, started);
+
+    success = success && upsertRollups(writer, records, count);
+
+    if (success) {
+        if (!executeStatement(writer, STATEMENT_COMMIT)) {
+            fprintf(stderr, "Ошибка завершения транзакции: %s\n", sqlite3_errmsg(writer->db));
+            executeStatement(writer, STATEMENT_ROLLBACK);
+            success = false;
+        }
+    } else {
+        executeStatement(writer, STATEMENT_ROLLBACK);
+    }
+
+    pthread_mutex_unlock(&context.writerLock);
+    return success;
 }
 
-TemperatureRecord* database_get_temperatures(const char *day_start, const char *day_end, int *count) {
-    const char *sql =
-        "SELECT timestamp, temperature FROM temperature_log "
-        "WHERE timestamp >= strftime('%s', ? || ' 00:00:00') "
-        "AND timestamp <= strftime('%s', ? || ' 23:59:59') "
-        "ORDER BY timestamp ASC;";
+static bool readLastRow(sqlite3_stmt *stmt, DatabaseStatement statement, TemperatureRecord **record) {
+    double started = monotonicMs();
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    if (found) {
+        *record = malloc(sizeof(TemperatureRecord));
+        if (*record) {
+            (*record)->timestamp = sqlite3_column_int(stmt, 0);
+            (*record)->temperature = sqlite3_column_double(stmt, 1);
+            (*record)->sensor = sqlite3_column_int(stmt, 2);
+        }
+    }
+    resetStatement(stmt, statement, started);
+    return found;
+}
 
-    sqlite3_stmt *stmt;
+TemperatureRecord* database_get_last_temperature(int *count) {
+    TemperatureRecord *record = NULL;
     *count = 0;
 
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        return NULL;
+    bool migrating;
+    DatabaseConnection *reader = acquireReader(&migrating);
+
+    // От нового раздела к старому, архив - последним
+    int partitionCount;
+    DatabasePartition *partitions = snapshotPartitions(LLONG_MIN, LLONG_MAX, &partitionCount);
+    bool found = false;
+    for (int i = partitionCount - 1; i >= 0 && !found; i--) {
+        sqlite3_stmt *stmt = partitionStatement(reader, &partitions[i], STATEMENT_GET_LAST_TEMPERATURE);
+        found = stmt && readLastRow(stmt, STATEMENT_GET_LAST_TEMPERATURE, &record);
     }
+    free(partitions);
 
+    if (!found && context.archiveEnd > 0) {
+        DatabaseStatement statement = migrating ? STATEMENT_GET_LAST_TEMPERATURE_MIGRATING
+                                                : STATEMENT_GET_LAST_TEMPERATURE;
+        readLastRow(reader->statements[statement], statement, &record);
+    }
+
+    releaseReader(reader, migrating);
+    *count = record ? 1 : 0;
+    return record;
+}
+
+// Передаёт строки выборки stmt в visit; false - ошибка или visit попросил остановиться (*stopped)
+static bool visitRows(sqlite3_stmt *stmt, DatabaseStatement statement, const char *day_start, const char *day_end,
+                      int sensor, TemperatureRecordVisitor visit, void *visitContext, int *count, bool *stopped) {
+    double started = monotonicMs();
     sqlite3_bind_text(stmt, 1, day_start, -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 2, day_end, -1, SQLITE_STATIC);
+    if (sensor >= 0) {
+        sqlite3_bind_int(stmt, 3, sensor);
+    }
 
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW) {
+        TemperatureRecord record = {
+            .timestamp = sqlite3_column_int(stmt, 0),
+            .temperature = sqlite3_column_double(stmt, 1),
+            .sensor = sqlite3_column_int(stmt, 2)
+        };
         (*count)++;
+        if (!visit(visitContext, &record)) {
+            *stopped = true;
+            result = SQLITE_DONE;
+            break;
+        }
+    }
+    if (result != SQLITE_DONE) {
+        fprintf(stderr, "Ошибка выборки: %s\n", sqlite3_errmsg(sqlite3_db_handle(stmt)));
     }
+    resetStatement(stmt, statement, started);
+    return result == SQLITE_DONE && !*stopped;
+}
 
-    if (*count == 0) {
-        sqlite3_finalize(stmt);
-        return NULL;
+int database_foreach_temperature(const char *day_start, const char *day_end, int sensor,
+                                 TemperatureRecordVisitor visit, void *visitContext) {
+    long long from = database_date_to_epoch(day_start);
+    long long to = database_date_to_epoch(day_end) + 86399;
+    DatabaseStatement partitionQuery = (sensor < 0) ? STATEMENT_GET_TEMPERATURES : STATEMENT_GET_SENSOR_TEMPERATURES;
+
+    bool migrating;
+    DatabaseConnection *reader = acquireReader(&migrating);
+    int count = 0;
+    bool stopped = false, success = true;
+
+    // Архив старше всех разделов, а разделы не пересекаются - порядок по времени сохраняется
+    if (from < context.archiveEnd) {
+        DatabaseStatement statement;
+        if (sensor < 0) {
+            statement = migrating ? STATEMENT_GET_TEMPERATURES_MIGRATING : STATEMENT_GET_TEMPERATURES;
+        } else {
+            statement = migrating ? STATEMENT_GET_SENSOR_TEMPERATURES_MIGRATING : STATEMENT_GET_SENSOR_TEMPERATURES;
+        }
+        success = visitRows(reader->statements[statement], statement, day_start, day_end, sensor,
+                            visit, visitContext, &count, &stopped);
     }
 
-    TemperatureRecord *records = malloc((*count) * sizeof(TemperatureRecord));
-    if (!records) {
-        sqlite3_finalize(stmt);
-        return NULL;
+    int partitionCount;
+    DatabasePartition *partitions = snapshotPartitions(from, to, &partitionCount);
+    for (int i = 0; i < partitionCount && success; i++) {
+        sqlite3_stmt *stmt = partitionStatement(reader, &partitions[i], partitionQuery);
+        success = stmt && visitRows(stmt, partitionQuery, day_start, day_end, sensor,
+                                    visit, visitContext, &count, &stopped);
     }
+    free(partitions);
 
-    sqlite3_reset(stmt);
+    releaseReader(reader, migrating);
+    return (success || stopped) ? count : -1;
+}
+
+long long database_rollup_seconds(int resolution) {
+    return rollupSeconds[resolution];
+}
+
+int database_foreach_rollup(int resolution, long long from, long long to, int sensor,
+                            TemperatureRollupVisitor visit, void *visitContext) {
+    bool migrating;
+    DatabaseConnection *reader = acquireReader(&migrating);
+    if (migrating) {
+        // Для ещё не перенесённых строк агрегатов нет
+        releaseReader(reader, migrating);
+        return -1;
+    }
+
+    DatabaseStatement statement = (sensor < 0) ? STATEMENT_GET_ROLLUPS : STATEMENT_GET_SENSOR_ROLLUPS;
+    double started = monotonicMs();
+    sqlite3_stmt *stmt = reader->statements[statement];
+    sqlite3_bind_int(stmt, 1, resolution);
+    sqlite3_bind_int64(stmt, 2, from / rollupSeconds[resolution] * rollupSeconds[resolution]);
+    sqlite3_bind_int64(stmt, 3, to);
+    if (sensor >= 0) {
+        sqlite3_bind_int(stmt, 4, sensor);
+    }
+
+    int count = 0;
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW) {
+        TemperatureRollup rollup = {
+            .resolution = sqlite3_column_int(stmt, 0),
+            .sensor = sqlite3_column_int(stmt, 1),
+            .bucket_start = sqlite3_column_int64(stmt, 2),
+            .bucket_end = sqlite3_column_int64(stmt, 3),
+            .count = sqlite3_column_int64(stmt, 4),
+            .sum = sqlite3_column_double(stmt, 5),
+            .min = sqlite3_column_double(stmt, 6),
+            .max = sqlite3_column_double(stmt, 7),
+            .mean = sqlite3_column_double(stmt, 8),
+            .m2 = sqlite3_column_double(stmt, 9)
+        };
+        count++;
+        if (!visit(visitContext, &rollup)) {
+            result = SQLITE_DONE;
+            break;
+        }
+    }
+    if (result != SQLITE_DONE) {
+        fprintf(stderr, "Ошибка выборки агрегатов: %s\n", sqlite3_errmsg(reader->db));
+        count = -1;
+    }
+
+    releaseStatement(reader, statement, started);
+    releaseReader(reader, migrating);
+    return count;
+}
+
+typedef struct {
+    TemperatureRecord *records;
+    int count;
+    int capacity;
+} RecordBuffer;
+
+// Буфер растёт вдвое: запрос выполняется один раз, без предварительного подсчёта строк
+static bool appendRecord(void *context, const TemperatureRecord *record) {
+    RecordBuffer *buffer = (RecordBuffer *)context;
+    if (buffer->count == buffer->capacity) {
+        int capacity = buffer->capacity ? buffer->capacity * 2 : 256;
+        TemperatureRecord *records = realloc(buffer->records, capacity * sizeof(TemperatureRecord));
+        if (!records) {
+            return false;
+        }
+        buffer->records = records;
+        buffer->capacity = capacity;
+    }
+    buffer->records[buffer->count++] = *record;
+    return true;
+}
+
+TemperatureRecord* database_get_temperatures(const char *day_start, const char *day_end, int sensor, int *count) {
+    RecordBuffer buffer = { NULL, 0, 0 };
     *count = 0;
 
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        records[*count].timestamp = sqlite3_column_int(stmt, 0);
-        records[*count].temperature = sqlite3_column_double(stmt, 1);
-        (*count)++;
+    int visited = database_foreach_temperature(day_start, day_end, sensor, appendRecord, &buffer);
+    if (visited < 0 || buffer.count < visited || buffer.count == 0) {
+        free(buffer.records);
+        return NULL;
     }
 
-    sqlite3_finalize(stmt);
-    return records;
-}
\ No newline at end of file
+    // Лишний запас после удвоения возвращается системе
+    TemperatureRecord *records = realloc(buffer.records, buffer.count * sizeof(TemperatureRecord));
+    *count = buffer.count;
+    return records ? records : buffer.records;
+}
@@ -7,17 +7,90 @@
 typedef struct {
     int timestamp;
     double temperature;
+    int sensor;
 } TemperatureRecord;
 
+typedef enum {
+    DATABASE_ROLLUP_MINUTE,
+    DATABASE_ROLLUP_HOUR,
+    DATABASE_ROLLUP_DAY,
+    DATABASE_ROLLUP_RESOLUTION_COUNT
+} DatabaseRollupResolution;
+
+// Агрегат за интервал [bucket_start, bucket_end); корзины выровнены по UTC
+typedef struct {
+    int resolution;
+    int sensor;
+    long long bucket_start;
+    long long bucket_end;
+    long long count;
+    double sum;
+    double min;
+    double max;
+    double mean;
+    double m2;
+} TemperatureRollup;
+
+typedef bool (*TemperatureRollupVisitor)(void *context, const TemperatureRollup *rollup);
+
+// Получает строки выборки по мере чтения из БД; false - прекратить обход.
+// На время обхода запрос занимает одно соединение из пула чтения.
+typedef bool (*TemperatureRecordVisitor)(void *context, const TemperatureRecord *record);
+
+// Время подготовки и выполнения одного запроса из кэша
+typedef struct {
+    const char *name;
+    unsigned long long prepares;
+    double prepare_ms;
+    unsigned long long executions;
+    double execute_ms;
+} DatabaseStatementStats;
+
+// Открывает соединение записи и пул соединений только для чтения, которые выдаются
+// на время одного запроса: чтение идёт параллельно с записью и другим чтением.
+// Отсчёты хранятся по месячным разделам: вставка идёт в раздел своего месяца, выборка за
+// период читает только пересекающиеся с ним разделы.
+// Старая таблица temperature_log переносится в temperature_samples фоновым потоком со своим
+// соединением; до конца переноса чтение объединяет обе таблицы, запись идёт только в новую
 bool database_init(const char *db_path);
 
 void database_close();
 
-bool database_insert_temperature(double temperature);
+// Копирует в stats до max записей статистики по запросам, возвращает их число
+int database_get_statement_stats(DatabaseStatementStats *stats, int max);
+
+void database_print_stats();
+
+bool database_insert_temperature(int sensor, double temperature);
+
+// Вставляет count записей одной транзакцией одним подготовленным запросом;
+// в той же транзакции обновляются агрегаты по минутам, часам и суткам
+bool database_insert_temperatures(const TemperatureRecord *records, int count);
 
 TemperatureRecord* database_get_last_temperature(int *count);
 
-TemperatureRecord* database_get_temperatures(const char *day_start, const char *day_end, int *count);
+// sensor < 0 - все датчики
+TemperatureRecord* database_get_temperatures(const char *day_start, const char *day_end, int sensor, int *count);
+
+// Обход выборки за период без промежуточного массива. Возвращает число переданных строк или -1
+int database_foreach_temperature(const char *day_start, const char *day_end, int sensor,
+                                 TemperatureRecordVisitor visit, void *visitContext);
+
+long long database_rollup_seconds(int resolution);
+
+// Полночь даты YYYY-MM-DD в секундах UTC - так же, как strftime('%s') в запросах за период
+long long database_date_to_epoch(const char *date);
+
+// Удаляет месячные разделы, все строки которых старше cutoff (секунды UTC), и очищает архив
+// строк до разбиения на разделы, если он целиком старше cutoff. Агрегаты не трогает.
+// Отсчёты старше удалённых разделов после этого в БД не пишутся (в агрегаты - пишутся).
+// Возвращает число удалённых таблиц или -1
+int database_drop_partitions_before(long long cutoff);
+
+// Обход агрегатов разрешения resolution с корзинами, пересекающими [from, to] (секунды UTC).
+// Возвращает число строк или -1, в том числе пока агрегаты неполны из-за переноса старой таблицы
+int database_foreach_rollup(int resolution, long long from, long long to, int sensor,
+                            TemperatureRollupVisitor visit, void *visitContext);
 
 
 #endif  // DATABASE_H
@@ -0,0 +1,485 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "CompressedLog.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+    #define seekFile(file, offset) _fseeki64((file), (offset), SEEK_SET)
+#else
+    #define seekFile(file, offset) fseeko((file), (off_t)(offset), SEEK_SET)
+#endif
+
+#define BLOCK_MAGIC       0x4B4C4254u  // "TBLK"
+#define PAYLOAD_BITS      ((COMPRESSED_LOG_BLOCK_SIZE - COMPRESSED_LOG_HEADER_SIZE) * 8)
+#define MAX_SAMPLE_BITS   (4 + 32 + 2 + 5 + 6 + 64)  // худший случай кодирования одного отсчёта
+#define SCAN_INDEX_BATCH  256
+
+static long long monotonicMs() {
+#ifdef _WIN32
+    return (long long)GetTickCount64();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+#endif
+}
+
+static void putU16(uint8_t *out, uint16_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+}
+
+static void putU32(uint8_t *out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out[i] = (uint8_t)(value >> (8 * i));
+}
+
+static void putI64(uint8_t *out, int64_t value) {
+    for (int i = 0; i < 8; i++) out[i] = (uint8_t)((uint64_t)value >> (8 * i));
+}
+
+static uint16_t getU16(const uint8_t *in) {
+    return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static uint32_t getU32(const uint8_t *in) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) value = (value << 8) | in[i];
+    return value;
+}
+
+static int64_t getI64(const uint8_t *in) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) value = (value << 8) | in[i];
+    return (int64_t)value;
+}
+
+// Биты пишутся и читаются от старшего к младшему
+static void writeBits(uint8_t *payload, size_t *position, uint64_t value, int bits) {
+    while (bits > 0) {
+        int available = 8 - (int)(*position & 7);
+        int take = (bits < available) ? bits : available;
+        uint8_t chunk = (uint8_t)((value >> (bits - take)) & ((1u << take) - 1));
+
+        payload[*position >> 3] |= (uint8_t)(chunk << (available - take));
+        *position += take;
+        bits -= take;
+    }
+}
+
+static uint64_t readBits(const uint8_t *payload, size_t *position, int bits) {
+    uint64_t value = 0;
+    while (bits > 0) {
+        int available = 8 - (int)(*position & 7);
+        int take = (bits < available) ? bits : available;
+        uint8_t chunk = (uint8_t)((payload[*position >> 3] >> (available - take)) & ((1u << take) - 1));
+
+        value = (value << take) | chunk;
+        *position += take;
+        bits -= take;
+    }
+    return value;
+}
+
+static uint64_t doubleBits(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static double bitsDouble(uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void resetBlock(CompressedLogBlock *block, uint16_t sensorId) {
+    memset(block, 0, sizeof(*block));
+    block->sensorId = sensorId;
+    block->blockIndex = -1;
+    block->lastLeading = -1;
+}
+
+static void encodeTimestamp(CompressedLogBlock *block, uint8_t *payload, int64_t deltaOfDelta) {
+    if (deltaOfDelta == 0) {
+        writeBits(payload, &block->bitLength, 0x0, 1);
+    } else if (deltaOfDelta >= -63 && deltaOfDelta <= 64) {
+        writeBits(payload, &block->bitLength, 0x2, 2);
+        writeBits(payload, &block->bitLength, (uint64_t)(deltaOfDelta + 63), 7);
+    } else if (deltaOfDelta >= -255 && deltaOfDelta <= 256) {
+        writeBits(payload, &block->bitLength, 0x6, 3);
+        writeBits(payload, &block->bitLength, (uint64_t)(deltaOfDelta + 255), 9);
+    } else if (deltaOfDelta >= -2047 && deltaOfDelta <= 2048) {
+        writeBits(payload, &block->bitLength, 0xE, 4);
+        writeBits(payload, &block->bitLength, (uint64_t)(deltaOfDelta + 2047), 12);
+    } else {
+        writeBits(payload, &block->bitLength, 0xF, 4);
+        writeBits(payload, &block->bitLength, (uint32_t)(int32_t)deltaOfDelta, 32);
+    }
+}
+
+static void encodeValue(CompressedLogBlock *block, uint8_t *payload, uint64_t valueBits) {
+    uint64_t xorBits = valueBits ^ block->lastValueBits;
+    block->lastValueBits = valueBits;
+
+    if (xorBits == 0) {
+        writeBits(payload, &block->bitLength, 0x0, 1);
+        return;
+    }
+
+    int leading = __builtin_clzll(xorBits);
+    int trailing = __builtin_ctzll(xorBits);
+    if (leading > 31) leading = 31;
+
+    // Значащие биты помещаются в окно предыдущего значения - пишем только их
+    if (block->lastLeading >= 0 && leading >= block->lastLeading && trailing >= block->lastTrailing) {
+        int meaningful = 64 - block->lastLeading - block->lastTrailing;
+        writeBits(payload, &block->bitLength, 0x2, 2);
+        writeBits(payload, &block->bitLength, xorBits >> block->lastTrailing, meaningful);
+        return;
+    }
+
+    int meaningful = 64 - leading - trailing;
+    writeBits(payload, &block->bitLength, 0x3, 2);
+    writeBits(payload, &block->bitLength, (uint64_t)leading, 5);
+    writeBits(payload, &block->bitLength, (uint64_t)(meaningful - 1), 6);
+    writeBits(payload, &block->bitLength, xorBits >> trailing, meaningful);
+    block->lastLeading = leading;
+    block->lastTrailing = trailing;
+}
+
+// false - отсчёт не помещается в блок, блок надо закрыть и начать новый
+static bool appendToBlock(CompressedLogBlock *block, int64_t timestampMs, double value) {
+    uint8_t *payload = block->data + COMPRESSED_LOG_HEADER_SIZE;
+
+    if (block->count == 0) {
+        block->firstTimestampMs = block->lastTimestampMs = timestampMs;
+        block->minTimestampMs = block->maxTimestampMs = timestampMs;
+        block->lastValueBits = doubleBits(value);
+        writeBits(payload, &block->bitLength, block->lastValueBits, 64);
+        block->count = 1;
+        return true;
+    }
+
+    int64_t delta = timestampMs - block->lastTimestampMs;
+    int64_t deltaOfDelta = delta - block->lastDelta;
+    if (block->count == UINT16_MAX || block->bitLength + MAX_SAMPLE_BITS > PAYLOAD_BITS ||
+        deltaOfDelta < INT32_MIN || deltaOfDelta > INT32_MAX) {
+        return false;
+    }
+
+    encodeTimestamp(block, payload, deltaOfDelta);
+    encodeValue(block, payload, doubleBits(value));
+
+    block->lastDelta = delta;
+    block->lastTimestampMs = timestampMs;
+    if (timestampMs < block->minTimestampMs) block->minTimestampMs = timestampMs;
+    if (timestampMs > block->maxTimestampMs) block->maxTimestampMs = timestampMs;
+    block->count++;
+    return true;
+}
+
+static void encodeIndexEntry(uint8_t *out, uint16_t sensorId, uint16_t count, int64_t minTimestampMs, int64_t maxTimestampMs) {
+    memset(out, 0, COMPRESSED_LOG_INDEX_ENTRY_SIZE);
+    putU16(out, sensorId);
+    putU16(out + 2, count);
+    putI64(out + 8, minTimestampMs);
+    putI64(out + 16, maxTimestampMs);
+}
+
+static void decodeIndexEntry(const uint8_t *in, CompressedLogIndexEntry *entry) {
+    entry->sensorId = getU16(in);
+    entry->count = getU16(in + 2);
+    entry->minTimestampMs = getI64(in + 8);
+    entry->maxTimestampMs = getI64(in + 16);
+}
+
+// Запись индекса восстанавливается из заголовка блока, если индекс отстал от файла
+static bool headerIndexEntry(const uint8_t *header, CompressedLogIndexEntry *entry) {
+    if (getU32(header) != BLOCK_MAGIC) {
+        memset(entry, 0, sizeof(*entry));
+        return false;
+    }
+    entry->sensorId = getU16(header + 4);
+    entry->count = getU16(header + 6);
+    entry->minTimestampMs = getI64(header + 24);
+    entry->maxTimestampMs = getI64(header + 32);
+    return true;
+}
+
+static bool writeBlock(CompressedLog *log, CompressedLogBlock *block) {
+    uint8_t *header = block->data;
+    putU32(header, BLOCK_MAGIC);
+    putU16(header + 4, block->sensorId);
+    putU16(header + 6, block->count);
+    putU32(header + 8, (uint32_t)block->bitLength);
+    putU32(header + 12, 0);
+    putI64(header + 16, block->firstTimestampMs);
+    putI64(header + 24, block->minTimestampMs);
+    putI64(header + 32, block->maxTimestampMs);
+
+    uint8_t entry[COMPRESSED_LOG_INDEX_ENTRY_SIZE];
+    encodeIndexEntry(entry, block->sensorId, block->count, block->minTimestampMs, block->maxTimestampMs);
+
+    bool success =
+        seekFile(log->file, block->blockIndex * COMPRESSED_LOG_BLOCK_SIZE) == 0 &&
+        fwrite(block->data, COMPRESSED_LOG_BLOCK_SIZE, 1, log->file) == 1 &&
+        seekFile(log->index, block->blockIndex * COMPRESSED_LOG_INDEX_ENTRY_SIZE) == 0 &&
+        fwrite(entry, sizeof(entry), 1, log->index) == 1;
+    if (!success) {
+        perror("Ошибка записи блока сжатого лога.\n");
+        return false;  // блок остаётся грязным и пишется повторно
+    }
+    block->dirty = false;
+    return true;
+}
+
+static long long fileSize(FILE *file) {
+    fseek(file, 0, SEEK_END);
+    long long size = ftell(file);
+    return (size > 0) ? size : 0;
+}
+
+static FILE* openForUpdate(const char *path) {
+    FILE *file = fopen(path, "r+b");
+    return file ? file : fopen(path, "w+b");
+}
+
+bool CompressedLogOpen(CompressedLog *log, const char *path) {
+    memset(log, 0, sizeof(*log));
+    strncpy(log->path, path, sizeof(log->path) - 1);
+    log->flushIntervalMs = COMPRESSED_LOG_FLUSH_MS;
+
+    char indexPath[sizeof(log->path) + 4];
+    snprintf(indexPath, sizeof(indexPath), "%s.idx", path);
+
+    log->file = openForUpdate(path);
+    log->index = openForUpdate(indexPath);
+    if (!log->file || !log->index) {
+        CompressedLogClose(log);
+        return false;
+    }
+
+    long long size = fileSize(log->file);
+    log->fileBlocks = (size + COMPRESSED_LOG_BLOCK_SIZE - 1) / COMPRESSED_LOG_BLOCK_SIZE;
+
+    // После аварии индекс мог не дописаться - восстанавливаем его по заголовкам блоков
+    long long indexed = fileSize(log->index) / COMPRESSED_LOG_INDEX_ENTRY_SIZE;
+    for (long long i = indexed; i < log->fileBlocks; i++) {
+        uint8_t header[COMPRESSED_LOG_HEADER_SIZE] = {0};
+        CompressedLogIndexEntry entry;
+        uint8_t encoded[COMPRESSED_LOG_INDEX_ENTRY_SIZE];
+
+        if (seekFile(log->file, i * COMPRESSED_LOG_BLOCK_SIZE) == 0) {
+            size_t bytesRead = fread(header, 1, sizeof(header), log->file);
+            (void)bytesRead;
+        }
+        headerIndexEntry(header, &entry);
+        encodeIndexEntry(encoded, entry.sensorId, entry.count, entry.minTimestampMs, entry.maxTimestampMs);
+        if (seekFile(log->index, i * COMPRESSED_LOG_INDEX_ENTRY_SIZE) != 0 || fwrite(encoded, sizeof(encoded), 1, log->index) != 1) {
+            perror("Ошибка восстановления индекса сжатого лога.\n");
+            break;
+        }
+    }
+
+    log->lastFlushMs = monotonicMs();
+    return true;
+}
+
+static CompressedLogBlock* findBlock(CompressedLog *log, uint16_t sensorId) {
+    for (size_t i = 0; i < log->blockCount; i++) {
+        if (log->blocks[i].sensorId == sensorId) {
+            return &log->blocks[i];
+        }
+    }
+
+    if (log->blockCount == log->blockCapacity) {
+        size_t capacity = log->blockCapacity ? log->blockCapacity * 2 : 4;
+        CompressedLogBlock *blocks = (CompressedLogBlock *)realloc(log->blocks, capacity * sizeof(CompressedLogBlock));
+        if (!blocks) return NULL;
+        log->blocks = blocks;
+        log->blockCapacity = capacity;
+    }
+
+    CompressedLogBlock *block = &log->blocks[log->blockCount++];
+    resetBlock(block, sensorId);
+    return block;
+}
+
+bool CompressedLogAppend(CompressedLog *log, uint16_t sensorId, int64_t timestampMs, double value) {
+    if (!log->file) return false;
+
+    CompressedLogBlock *block = findBlock(log, sensorId);
+    if (!block) return false;
+
+    if (!appendToBlock(block, timestampMs, value)) {
+        // Заполненный блок не сбрасывается, пока не записан: его отсчёты не теряются
+        if (!writeBlock(log, block)) {
+            log->rejectedSamples++;
+            return false;
+        }
+        log->sealedBlocks++;
+        resetBlock(block, sensorId);
+        appendToBlock(block, timestampMs, value);
+    }
+
+    if (block->blockIndex < 0) {
+        block->blockIndex = log->fileBlocks++;
+    }
+    block->dirty = true;
+    log->samples++;
+    return true;
+}
+
+void CompressedLogFlush(CompressedLog *log) {
+    if (!log->file) return;
+
+    for (size_t i = 0; i < log->blockCount; i++) {
+        if (log->blocks[i].dirty) {
+            writeBlock(log, &log->blocks[i]);
+        }
+    }
+    if (fflush(log->file) != 0 || fflush(log->index) != 0) {
+        perror("Ошибка: не удалось сбросить сжатый лог на диск.\n");
+    }
+    log->lastFlushMs = monotonicMs();
+}
+
+void CompressedLogTick(CompressedLog *log) {
+    if (!log->file || log->flushIntervalMs <= 0) return;
+
+    if (monotonicMs() - log->lastFlushMs >= log->flushIntervalMs) {
+        CompressedLogFlush(log);
+    }
+}
+
+void CompressedLogClose(CompressedLog *log) {
+    CompressedLogFlush(log);
+    if (log->file) fclose(log->file);
+    if (log->index) fclose(log->index);
+    free(log->blocks);
+    log->file = log->index = NULL;
+    log->blocks = NULL;
+    log->blockCount = log->blockCapacity = 0;
+}
+
+static long long decodeBlock(const uint8_t *block, int64_t fromMs, int64_t toMs, CompressedLogVisit visit, void *context) {
+    if (getU32(block) != BLOCK_MAGIC) return 0;
+
+    uint16_t sensorId = getU16(block + 4);
+    uint16_t count = getU16(block + 6);
+    size_t bitLength = getU32(block + 8);
+    int64_t timestamp = getI64(block + 16);
+    if (bitLength > PAYLOAD_BITS) return 0;
+
+    const uint8_t *payload = block + COMPRESSED_LOG_HEADER_SIZE;
+    size_t position = 0;
+    int64_t delta = 0;
+    uint64_t valueBits = 0;
+    int leading = 0, trailing = 0;
+    long long visited = 0;
+
+    for (uint16_t i = 0; i < count && position <= bitLength; i++) {
+        if (i == 0) {
+            valueBits = readBits(payload, &position, 64);
+        } else {
+            int64_t deltaOfDelta;
+            if (!readBits(payload, &position, 1)) {
+                deltaOfDelta = 0;
+            } else if (!readBits(payload, &position, 1)) {
+                deltaOfDelta = (int64_t)readBits(payload, &position, 7) - 63;
+            } else if (!readBits(payload, &position, 1)) {
+                deltaOfDelta = (int64_t)readBits(payload, &position, 9) - 255;
+            } else if (!readBits(payload, &position, 1)) {
+                deltaOfDelta = (int64_t)readBits(payload, &position, 12) - 2047;
+            } else {
+                deltaOfDelta = (int32_t)(uint32_t)readBits(payload, &position, 32);
+            }
+            delta += deltaOfDelta;
+            timestamp += delta;
+
+            if (readBits(payload, &position, 1)) {
+                if (readBits(payload, &position, 1)) {
+                    leading = (int)readBits(payload, &position, 5);
+                    int meaningful = (int)readBits(payload, &position, 6) + 1;
+                    trailing = 64 - leading - meaningful;
+                }
+                int meaningful = 64 - leading - trailing;
+                valueBits ^= readBits(payload, &position, meaningful) << trailing;
+            }
+        }
+
+        if (timestamp >= fromMs && timestamp < toMs) {
+            visit(context, sensorId, timestamp, bitsDouble(valueBits));
+            visited++;
+        }
+    }
+    return visited;
+}
+
+long long CompressedLogScan(const char *path, int64_t fromMs, int64_t toMs, int sensorId, CompressedLogVisit visit, void *context) {
+    char indexPath[300];
+    snprintf(indexPath, sizeof(indexPath), "%s.idx", path);
+
+    FILE *file = fopen(path, "rb");
+    if (!file) return -1;
+    FILE *index = fopen(indexPath, "rb");
+
+    long long fileBlocks = (fileSize(file) + COMPRESSED_LOG_BLOCK_SIZE - 1) / COMPRESSED_LOG_BLOCK_SIZE;
+    long long indexed = index ? fileSize(index) / COMPRESSED_LOG_INDEX_ENTRY_SIZE : 0;
+    if (index) seekFile(index, 0);
+
+    uint8_t *block = (uint8_t *)malloc(COMPRESSED_LOG_BLOCK_SIZE);
+    uint8_t *entries = (uint8_t *)malloc(SCAN_INDEX_BATCH * COMPRESSED_LOG_INDEX_ENTRY_SIZE);
+    if (!block || !entries) {
+        free(block);
+        free(entries);
+        fclose(file);
+        if (index) fclose(index);
+        return -1;
+    }
+
+    long long visited = 0;
+    size_t batchCount = 0, batchPosition = 0;
+    for (long long i = 0; i < fileBlocks; i++) {
+        CompressedLogIndexEntry entry;
+
+        if (i < indexed) {
+            if (batchPosition == batchCount) {
+                batchCount = fread(entries, COMPRESSED_LOG_INDEX_ENTRY_SIZE, SCAN_INDEX_BATCH, index);
+                batchPosition = 0;
+                if (batchCount == 0) {
+                    indexed = i;
+                    i--;
+                    continue;
+                }
+            }
+            decodeIndexEntry(entries + batchPosition++ * COMPRESSED_LOG_INDEX_ENTRY_SIZE, &entry);
+        } else {
+            // Индекса нет или он короче файла - диапазон берём из заголовка блока
+            uint8_t header[COMPRESSED_LOG_HEADER_SIZE] = {0};
+            if (seekFile(file, i * COMPRESSED_LOG_BLOCK_SIZE) != 0 || fread(header, 1, sizeof(header), file) != sizeof(header)) {
+                break;
+            }
+            headerIndexEntry(header, &entry);
+        }
+
+        if (entry.count == 0 || entry.maxTimestampMs < fromMs || entry.minTimestampMs >= toMs ||
+            (sensorId >= 0 && entry.sensorId != (uint16_t)sensorId)) {
+            continue;
+        }
+
+        memset(block, 0, COMPRESSED_LOG_BLOCK_SIZE);
+        if (seekFile(file, i * COMPRESSED_LOG_BLOCK_SIZE) != 0 || fread(block, 1, COMPRESSED_LOG_BLOCK_SIZE, file) == 0) {
+            break;
+        }
+        visited += decodeBlock(block, fromMs, toMs, visit, context);
+    }
+
+    free(block);
+    free(entries);
+    fclose(file);
+    if (index) fclose(index);
+    return visited;
+}
@@ -0,0 +1,79 @@
+#ifndef COMPRESSED_LOG_H
+#define COMPRESSED_LOG_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Двоичный лог отсчётов в стиле Gorilla: метки времени - разность разностей, значения - XOR
+// с предыдущим. Файл состоит из блоков фиксированного размера, в каждом - отсчёты одного датчика.
+// Рядом лежит индекс "<path>.idx": запись i описывает блок i (датчик, число отсчётов, диапазон времени).
+#define COMPRESSED_LOG_BLOCK_SIZE       4096
+#define COMPRESSED_LOG_HEADER_SIZE      40
+#define COMPRESSED_LOG_INDEX_ENTRY_SIZE 24
+#define COMPRESSED_LOG_FLUSH_MS         1000
+
+typedef struct {
+    uint16_t sensorId;
+    uint16_t count;
+    int64_t minTimestampMs;
+    int64_t maxTimestampMs;
+} CompressedLogIndexEntry;
+
+// Открытый блок одного датчика; дописывается в памяти и перезаписывается на месте при сбросе
+typedef struct {
+    uint16_t sensorId;
+    long long blockIndex;  // -1 - блок пуст и места в файле ещё не занял
+    uint16_t count;
+    size_t bitLength;
+    int64_t firstTimestampMs;
+    int64_t lastTimestampMs;
+    int64_t minTimestampMs;
+    int64_t maxTimestampMs;
+    int64_t lastDelta;
+    uint64_t lastValueBits;
+    int lastLeading;       // -1 - окна значащих битов ещё нет
+    int lastTrailing;
+    bool dirty;
+    uint8_t data[COMPRESSED_LOG_BLOCK_SIZE];
+} CompressedLogBlock;
+
+typedef struct {
+    FILE *file;
+    FILE *index;
+    char path[256];
+    CompressedLogBlock *blocks;
+    size_t blockCount;
+    size_t blockCapacity;
+    long long fileBlocks;
+    int flushIntervalMs;
+    long long lastFlushMs;
+    unsigned long long samples;
+    unsigned long long sealedBlocks;
+    unsigned long long rejectedSamples;  // не приняты: заполненный блок не удалось записать
+} CompressedLog;
+
+typedef void (*CompressedLogVisit)(void *context, uint16_t sensorId, int64_t timestampMs, double value);
+
+// Открывает лог для дозаписи (создаёт, если его нет); новые отсчёты идут в новые блоки
+bool CompressedLogOpen(CompressedLog *log, const char *path);
+
+// false - отсчёт не принят, в том числе если не удалось записать заполненный блок;
+// такой блок остаётся в памяти и записывается при следующей попытке
+bool CompressedLogAppend(CompressedLog *log, uint16_t sensorId, int64_t timestampMs, double value);
+
+// Перезаписывает на диске изменившиеся открытые блоки и их записи индекса
+void CompressedLogFlush(CompressedLog *log);
+
+// Сбрасывает лог, если прошло flushIntervalMs с предыдущего сброса
+void CompressedLogTick(CompressedLog *log);
+
+void CompressedLogClose(CompressedLog *log);
+
+// Отдаёт visit отсчёты из [fromMs, toMs) датчика sensorId (< 0 - всех), читая только блоки,
+// чей диапазон по индексу пересекается с интервалом. Порядок - по блокам, внутри датчика по времени.
+// Возвращает число отданных отсчётов или -1.
+long long CompressedLogScan(const char *path, int64_t fromMs, int64_t toMs, int sensorId, CompressedLogVisit visit, void *context);
+
+#endif // COMPRESSED_LOG_H
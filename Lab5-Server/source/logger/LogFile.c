@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "LogFile.h"
+#include "LogRetention.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <unistd.h>
+#endif
+
+static long long monotonicMs() {
+#ifdef _WIN32
+    return (long long)GetTickCount64();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+#endif
+}
+
+LogFlushPolicy LogFlushPolicyDefault() {
+    LogFlushPolicy policy = {
+        .bufferSize = LOG_FILE_DEFAULT_BUFFER_SIZE,
+        .flushEveryRecords = LOG_FILE_DEFAULT_FLUSH_RECORDS,
+        .flushIntervalMs = LOG_FILE_DEFAULT_FLUSH_MS
+    };
+    return policy;
+}
+
+bool LogFileOpen(LogFile *log, const char *path, const char *mode, const LogFlushPolicy *policy) {
+    memset(log, 0, sizeof(*log));
+    log->policy = policy ? *policy : LogFlushPolicyDefault();
+    strncpy(log->path, path, sizeof(log->path) - 1);
+
+    log->file = fopen(path, mode);
+    if (!log->file) {
+        return false;
+    }
+
+    if (log->policy.bufferSize > 0) {
+        log->buffer = (char *)malloc(log->policy.bufferSize);
+        if (log->buffer) {
+            setvbuf(log->file, log->buffer, _IOFBF, log->policy.bufferSize);
+        }
+    }
+    log->lastFlushMs = monotonicMs();
+    return true;
+}
+
+void LogFileWriteLine(LogFile *log, const char *line) {
+    if (!log->file) return;
+
+    fputs(line, log->file);
+    fputc('\n', log->file);
+    log->records++;
+    log->pendingRecords++;
+
+    if (log->policy.flushEveryRecords > 0 && log->pendingRecords >= log->policy.flushEveryRecords) {
+        LogFileFlush(log);
+    }
+}
+
+void LogFileTick(LogFile *log) {
+    if (!log->file || log->pendingRecords == 0 || log->policy.flushIntervalMs <= 0) return;
+
+    if (monotonicMs() - log->lastFlushMs >= log->policy.flushIntervalMs) {
+        LogFileFlush(log);
+    }
+}
+
+void LogFileFlush(LogFile *log) {
+    if (!log->file) return;
+
+    if (fflush(log->file) != 0) {
+        perror("Ошибка: не удалось сбросить лог на диск.\n");
+    }
+    log->pendingRecords = 0;
+    log->lastFlushMs = monotonicMs();
+    log->flushes++;
+}
+
+bool LogFileSync(LogFile *log) {
+    if (!log->file) return true;
+
+    LogFileFlush(log);
+#ifndef _WIN32
+    if (fsync(fileno(log->file)) != 0) {
+        perror("Ошибка: не удалось записать лог на диск.\n");
+        return false;
+    }
+#endif
+    return true;
+}
+
+bool LogFileRetain(LogFile *log, time_t cutoff) {
+    if (!log->file) return false;
+
+    LogFileFlush(log);
+    bool success = LogRetentionApply(log->path, cutoff);
+    // Файл мог стать короче - следующие записи должны лечь в новый конец, а не в старую позицию
+    fseek(log->file, 0, SEEK_END);
+    return success;
+}
+
+void LogFileClose(LogFile *log) {
+    if (!log->file) return;
+
+    LogFileFlush(log);
+    fclose(log->file);
+    free(log->buffer);
+    log->file = NULL;
+    log->buffer = NULL;
+}
@@ -0,0 +1,53 @@
+#ifndef LOG_FILE_H
+#define LOG_FILE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#define LOG_FILE_DEFAULT_BUFFER_SIZE   65536
+#define LOG_FILE_DEFAULT_FLUSH_RECORDS 1024
+#define LOG_FILE_DEFAULT_FLUSH_MS      1000
+
+// Когда сбрасывать буфер на диск: после N записей или через T мс после предыдущего сброса
+// (что наступит раньше), а также при закрытии. 0 отключает соответствующее условие.
+typedef struct {
+    size_t bufferSize;
+    unsigned flushEveryRecords;
+    int flushIntervalMs;
+} LogFlushPolicy;
+
+// Постоянно открытый файл лога с собственным буфером вместо fopen/fclose на каждую запись
+typedef struct {
+    FILE *file;
+    char path[256];
+    char *buffer;
+    LogFlushPolicy policy;
+    unsigned pendingRecords;
+    long long lastFlushMs;
+    unsigned long long records;
+    unsigned long long flushes;
+} LogFile;
+
+LogFlushPolicy LogFlushPolicyDefault();
+
+bool LogFileOpen(LogFile *log, const char *path, const char *mode, const LogFlushPolicy *policy);
+
+void LogFileWriteLine(LogFile *log, const char *line);
+
+// Сбрасывает буфер, если истёк интервал политики; вызывается из цикла логгера
+void LogFileTick(LogFile *log);
+
+void LogFileFlush(LogFile *log);
+
+// Сбрасывает буфер и дожидается записи файла на диск (fsync)
+bool LogFileSync(LogFile *log);
+
+// Сбрасывает буфер и удаляет из файла записи старше cutoff (см. LogRetentionApply).
+// Вызывать из потока, который пишет в этот лог.
+bool LogFileRetain(LogFile *log, time_t cutoff);
+
+void LogFileClose(LogFile *log);
+
+#endif // LOG_FILE_H
@@ -0,0 +1,189 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+    #define _GNU_SOURCE  // fallocate и FALLOC_FL_COLLAPSE_RANGE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "LogRetention.h"
+
+#ifdef _WIN32
+    #include <io.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <errno.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#define LOG_RETENTION_KEY_SIZE 20
+
+static void formatCutoffKey(time_t cutoff, char *key) {
+    struct tm tmCutoff;
+#ifdef _WIN32
+    localtime_s(&tmCutoff, &cutoff);
+#else
+    localtime_r(&cutoff, &tmCutoff);
+#endif
+    strftime(key, LOG_RETENTION_KEY_SIZE, "%Y-%m-%d %H:%M:%S", &tmCutoff);
+}
+
+// Длина метки времени в начале строки: 19, 16 или 10 символов; 0 - строка без метки (например, заполнитель)
+static size_t recordKeyLength(const char *line, size_t available) {
+    if (available < 10 || !isdigit((unsigned char)line[0]) || line[4] != '-' || line[7] != '-') {
+        return 0;
+    }
+    if (available >= 19 && line[10] == ' ' && line[13] == ':' && line[16] == ':') {
+        return 19;
+    }
+    if (available >= 16 && line[10] == ' ' && line[13] == ':') {
+        return 16;
+    }
+    return 10;
+}
+
+static size_t nextLineStart(const char *data, size_t size, size_t offset) {
+    if (offset == 0) return 0;
+    const char *newline = memchr(data + offset - 1, '\n', size - offset + 1);
+    return newline ? (size_t)(newline - data) + 1 : size;
+}
+
+// Начало первой строки с меткой времени, начинающейся не раньше offset
+static size_t nextRecord(const char *data, size_t size, size_t offset) {
+    size_t line = nextLineStart(data, size, offset);
+    while (line < size && recordKeyLength(data + line, size - line) == 0) {
+        line = nextLineStart(data, size, line + 1);
+    }
+    return line;
+}
+
+size_t LogRetentionFindCutoff(const char *data, size_t size, const char *cutoffKey) {
+    size_t low = 0, high = size;
+
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        size_t record = nextRecord(data, size, middle);
+        if (record == size || memcmp(data + record, cutoffKey, recordKeyLength(data + record, size - record)) >= 0) {
+            high = middle;
+        } else {
+            low = record + 1;
+        }
+    }
+    return nextRecord(data, size, low);
+}
+
+#ifndef _WIN32
+static bool copyTail(int fd, const char *data, size_t from, size_t size) {
+    char *chunk = (char *)malloc(LOG_RETENTION_COPY_CHUNK);
+    if (!chunk) return false;
+
+    size_t written = 0;
+    while (from + written < size) {
+        size_t length = size - from - written;
+        if (length > LOG_RETENTION_COPY_CHUNK) length = LOG_RETENTION_COPY_CHUNK;
+
+        memcpy(chunk, data + from + written, length);
+        if (pwrite(fd, chunk, length, written) != (ssize_t)length) {
+            free(chunk);
+            return false;
+        }
+        written += length;
+    }
+    free(chunk);
+    return ftruncate(fd, written) == 0;
+}
+
+#if defined(__linux__) && defined(FALLOC_FL_COLLAPSE_RANGE)
+// Вырезает без копирования самый длинный префикс из целых блоков, который кончается на
+// границе записи; до нескольких блоков записей старше cutoff за ним остаются. При false файл не изменён
+static bool collapsePrefix(int fd, const char *data, size_t cutoff, size_t blockSize) {
+    size_t aligned = cutoff - cutoff % blockSize;
+    while (aligned > 0 && data[aligned - 1] != '\n') {
+        aligned -= blockSize;
+    }
+    return aligned > 0 && fallocate(fd, FALLOC_FL_COLLAPSE_RANGE, 0, aligned) == 0;
+}
+#endif
+
+bool LogRetentionApply(const char *filePath, time_t cutoff) {
+    int fd = open(filePath, O_RDWR);
+    if (fd == -1) return false;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        close(fd);
+        return fileStat.st_size == 0;
+    }
+    size_t size = (size_t)fileStat.st_size;
+
+    char *data = (char *)mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    char cutoffKey[LOG_RETENTION_KEY_SIZE];
+    formatCutoffKey(cutoff, cutoffKey);
+    size_t offset = LogRetentionFindCutoff(data, size, cutoffKey);
+
+    bool success = true;
+    if (offset == size) {
+        success = ftruncate(fd, 0) == 0;
+    } else if (offset > 0) {
+#if defined(__linux__) && defined(FALLOC_FL_COLLAPSE_RANGE)
+        // Короткий хвост дешевле переписать - так обрезка точна; длинный вырезается блоками
+        success = (size - offset > LOG_RETENTION_COLLAPSE_MIN_TAIL &&
+                   collapsePrefix(fd, data, offset, (size_t)fileStat.st_blksize)) ||
+                  copyTail(fd, data, offset, size);
+#else
+        success = copyTail(fd, data, offset, size);
+#endif
+    }
+
+    munmap(data, size);
+    close(fd);
+    return success;
+}
+#else
+bool LogRetentionApply(const char *filePath, time_t cutoff) {
+    FILE *file = fopen(filePath, "r+b");
+    if (!file) return false;
+
+    char cutoffKey[LOG_RETENTION_KEY_SIZE];
+    formatCutoffKey(cutoff, cutoffKey);
+
+    // Без mmap ищем границу последовательно, но тоже без загрузки файла в память
+    char line[256];
+    long offset = 0;
+    while (fgets(line, sizeof(line), file)) {
+        size_t keyLength = recordKeyLength(line, strlen(line));
+        if (keyLength > 0 && memcmp(line, cutoffKey, keyLength) >= 0) break;
+        offset = ftell(file);
+    }
+
+    char *chunk = (char *)malloc(LOG_RETENTION_COPY_CHUNK);
+    if (!chunk) {
+        fclose(file);
+        return false;
+    }
+
+    long written = 0;
+    size_t length;
+    fseek(file, offset, SEEK_SET);
+    while ((length = fread(chunk, 1, LOG_RETENTION_COPY_CHUNK, file)) > 0) {
+        fseek(file, written, SEEK_SET);
+        fwrite(chunk, 1, length, file);
+        written += (long)length;
+        fseek(file, offset + written, SEEK_SET);
+    }
+    free(chunk);
+
+    fflush(file);
+    bool success = _chsize(_fileno(file), written) == 0;
+    fclose(file);
+    return success;
+}
+#endif
@@ -0,0 +1,22 @@
+#ifndef LOG_RETENTION_H
+#define LOG_RETENTION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#define LOG_RETENTION_COPY_CHUNK        65536
+#define LOG_RETENTION_COLLAPSE_MIN_TAIL (16 * LOG_RETENTION_COPY_CHUNK)  // хвост короче переписывается
+
+// Удаляет из начала отсортированного по времени лога все записи старше cutoff.
+// Понимает строки "YYYY-MM-DD HH:MM:SS ...", "YYYY-MM-DD HH:00 ..." и "YYYY-MM-DD ...".
+// Граница ищется двоичным поиском по mmap файла, затем хвост один раз переносится в начало
+// (или, если хвост длинный и ФС это умеет, начало вырезается fallocate(FALLOC_FL_COLLAPSE_RANGE)
+// с точностью до блока).
+// Память постоянна, время пропорционально объёму оставшихся данных.
+bool LogRetentionApply(const char *filePath, time_t cutoff);
+
+// Смещение первой записи не старше cutoffKey ("YYYY-MM-DD HH:MM:SS"); size, если таких нет
+size_t LogRetentionFindCutoff(const char *data, size_t size, const char *cutoffKey);
+
+#endif // LOG_RETENTION_H
@@ -0,0 +1,38 @@
+#include "Random.h"
+
+static inline uint64_t rotateLeft(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// Состояние раскладывается из seed через splitmix64, как рекомендуют авторы xoshiro
+static uint64_t splitMix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void RandomSeed(RandomState *random, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        random->s[i] = splitMix64(&seed);
+    }
+}
+
+uint64_t RandomNext(RandomState *random) {
+    uint64_t *s = random->s;
+    uint64_t result = rotateLeft(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotateLeft(s[3], 45);
+
+    return result;
+}
+
+double RandomUniform(RandomState *random) {
+    return (RandomNext(random) >> 11) * 0x1.0p-53;
+}
@@ -0,0 +1,18 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+
+// xoshiro256**: своё состояние у каждого владельца, без общей блокировки rand()
+typedef struct {
+    uint64_t s[4];
+} RandomState;
+
+void RandomSeed(RandomState *random, uint64_t seed);
+
+uint64_t RandomNext(RandomState *random);
+
+// Равномерно в [0, 1)
+double RandomUniform(RandomState *random);
+
+#endif // RANDOM_H
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "Rollup.h"
+
+#ifndef _WIN32
+    #include <unistd.h>
+#endif
+
+#define ROLLUP_CHECKPOINT_HEADER    "rollup-checkpoint 2"
+#define ROLLUP_CHECKPOINT_HEADER_V1 "rollup-checkpoint 1"  // с минутными корзинами под разрешением 0
+
+void RollupAccumulatorReset(RollupAccumulator *accumulator) {
+    memset(accumulator, 0, sizeof(*accumulator));
+}
+
+void RollupAccumulatorAdd(RollupAccumulator *accumulator, double value) {
+    if (accumulator->count == 0 || value < accumulator->min) accumulator->min = value;
+    if (accumulator->count == 0 || value > accumulator->max) accumulator->max = value;
+
+    accumulator->count++;
+    accumulator->sum += value;
+
+    double delta = value - accumulator->mean;
+    accumulator->mean += delta / (double)accumulator->count;
+    accumulator->m2 += delta * (value - accumulator->mean);
+}
+
+double RollupAccumulatorStdDev(const RollupAccumulator *accumulator) {
+    return (accumulator->count > 1) ? sqrt(accumulator->m2 / (double)accumulator->count) : 0.0;
+}
+
+void RollupBucketBounds(RollupResolution resolution, time_t timestamp, time_t *start, time_t *end) {
+    struct tm local;
+#ifdef _WIN32
+    localtime_s(&local, &timestamp);
+#else
+    localtime_r(&timestamp, &local);
+#endif
+    local.tm_min = local.tm_sec = 0;
+    if (resolution == ROLLUP_DAY) local.tm_hour = 0;
+    local.tm_isdst = -1;
+    *start = mktime(&local);
+
+    if (resolution == ROLLUP_DAY) local.tm_mday++;
+    else local.tm_hour++;
+    local.tm_isdst = -1;
+    *end = mktime(&local);
+
+    // Переход на летнее/зимнее время: корзина не короче часа
+    if (*end <= *start) *end = *start + 3600;
+}
+
+void RollupEngineInit(RollupEngine *engine, RollupEmit emit, void *context) {
+    memset(engine, 0, sizeof(*engine));
+    engine->emit = emit;
+    engine->context = context;
+    engine->graceSeconds = ROLLUP_GRACE_SECONDS;
+}
+
+static RollupSeries* findSeries(RollupEngine *engine, uint16_t sensorId) {
+    if (engine->lastSeries < engine->seriesCount && engine->series[engine->lastSeries].sensorId == sensorId) {
+        return &engine->series[engine->lastSeries];
+    }
+
+    for (size_t i = 0; i < engine->seriesCount; i++) {
+        if (engine->series[i].sensorId == sensorId) {
+            engine->lastSeries = i;
+            return &engine->series[i];
+        }
+    }
+
+    if (engine->seriesCount == engine->seriesCapacity) {
+        size_t capacity = engine->seriesCapacity ? engine->seriesCapacity * 2 : 8;
+        RollupSeries *series = (RollupSeries *)realloc(engine->series, capacity * sizeof(RollupSeries));
+        if (!series) return NULL;
+        engine->series = series;
+        engine->seriesCapacity = capacity;
+    }
+
+    RollupSeries *series = &engine->series[engine->seriesCount];
+    memset(series, 0, sizeof(*series));
+    series->sensorId = sensorId;
+    for (int resolution = 0; resolution < ROLLUP_RESOLUTION_COUNT; resolution++) {
+        series->buckets[resolution].resolution = (RollupResolution)resolution;
+        series->buckets[resolution].sensorId = sensorId;
+    }
+    engine->lastSeries = engine->seriesCount++;
+    return series;
+}
+
+static void emitBucket(RollupEngine *engine, RollupBucket *bucket) {
+    if (bucket->stats.count > 0) {
+        engine->emit(engine->context, bucket);
+        engine->emitted++;
+    }
+    RollupAccumulatorReset(&bucket->stats);
+}
+
+void RollupEngineAdd(RollupEngine *engine, uint16_t sensorId, time_t timestamp, double value) {
+    RollupSeries *series = findSeries(engine, sensorId);
+    if (!series) return;
+
+    for (int resolution = 0; resolution < ROLLUP_RESOLUTION_COUNT; resolution++) {
+        RollupBucket *bucket = &series->buckets[resolution];
+
+        // Границы считаются только при смене корзины, а не на каждый отсчёт
+        if (bucket->end == 0 || timestamp >= bucket->end) {
+            emitBucket(engine, bucket);
+            RollupBucketBounds((RollupResolution)resolution, timestamp, &bucket->start, &bucket->end);
+        } else if (timestamp < bucket->start) {
+            engine->lateSamples++;
+            continue;
+        }
+        RollupAccumulatorAdd(&bucket->stats, value);
+    }
+}
+
+void RollupEngineAdvance(RollupEngine *engine, time_t now) {
+    for (size_t i = 0; i < engine->seriesCount; i++) {
+        for (int resolution = 0; resolution < ROLLUP_RESOLUTION_COUNT; resolution++) {
+            RollupBucket *bucket = &engine->series[i].buckets[resolution];
+            if (bucket->stats.count > 0 && now >= bucket->end + engine->graceSeconds) {
+                emitBucket(engine, bucket);
+                // Границы остаются, чтобы запоздавший отсчёт считался опоздавшим,
+                // а не открыл ту же корзину заново и не отдал её второй раз
+                bucket->start = bucket->end;
+            }
+        }
+    }
+}
+
+bool RollupEngineSave(const RollupEngine *engine, const char *path) {
+    char temporaryPath[300];
+    snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", path);
+
+    FILE *file = fopen(temporaryPath, "w");
+    if (!file) return false;
+
+    fprintf(file, "%s\n", ROLLUP_CHECKPOINT_HEADER);
+    for (size_t i = 0; i < engine->seriesCount; i++) {
+        for (int resolution = 0; resolution < ROLLUP_RESOLUTION_COUNT; resolution++) {
+            const RollupBucket *bucket = &engine->series[i].buckets[resolution];
+            const RollupAccumulator *stats = &bucket->stats;
+            // Закрытая корзина сохраняется без отсчётов, чтобы после перезапуска
+            // запоздавший отсчёт не открыл её заново
+            if (stats->count == 0 && (bucket->end == 0 || bucket->start != bucket->end)) continue;
+
+            // %.17g - чтобы double восстановился без потерь
+            fprintf(file, "%u %d %lld %lld %llu %.17g %.17g %.17g %.17g %.17g\n",
+                    bucket->sensorId, resolution, (long long)bucket->start, (long long)bucket->end,
+                    stats->count, stats->sum, stats->min, stats->max, stats->mean, stats->m2);
+        }
+    }
+
+    bool success = fflush(file) == 0;
+#ifndef _WIN32
+    success = success && fsync(fileno(file)) == 0;
+#endif
+    success = (fclose(file) == 0) && success;
+    if (!success) {
+        remove(temporaryPath);
+        return false;
+    }
+
+#ifdef _WIN32
+    remove(path);
+#endif
+    return rename(temporaryPath, path) == 0;
+}
+
+bool RollupEngineLoad(RollupEngine *engine, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) return false;
+
+    char line[512];
+    int version = 0;
+    if (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, ROLLUP_CHECKPOINT_HEADER, strlen(ROLLUP_CHECKPOINT_HEADER)) == 0) version = 2;
+        else if (strncmp(line, ROLLUP_CHECKPOINT_HEADER_V1, strlen(ROLLUP_CHECKPOINT_HEADER_V1)) == 0) version = 1;
+    }
+    if (version == 0) {
+        fclose(file);
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        unsigned sensorId;
+        int resolution;
+        long long start, end;
+        RollupAccumulator stats;
+
+        if (sscanf(line, "%u %d %lld %lld %llu %lg %lg %lg %lg %lg",
+                   &sensorId, &resolution, &start, &end, &stats.count,
+                   &stats.sum, &stats.min, &stats.max, &stats.mean, &stats.m2) != 10) {
+            continue;
+        }
+        if (version == 1) {
+            resolution--;  // минутные корзины старой точки пропускаются
+        }
+        if (resolution < 0 || resolution >= ROLLUP_RESOLUTION_COUNT) {
+            continue;
+        }
+
+        RollupSeries *series = findSeries(engine, (uint16_t)sensorId);
+        if (!series) break;
+
+        RollupBucket *bucket = &series->buckets[resolution];
+        bucket->start = (time_t)start;
+        bucket->end = (time_t)end;
+        bucket->stats = stats;
+    }
+
+    fclose(file);
+    return true;
+}
+
+void RollupEngineClose(RollupEngine *engine) {
+    free(engine->series);
+    engine->series = NULL;
+    engine->seriesCount = engine->seriesCapacity = 0;
+}
@@ -0,0 +1,80 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define ROLLUP_GRACE_SECONDS 2  // сколько ждать запоздавшие отсчёты после конца корзины
+
+// Минутные агрегаты строит БД (temperature_rollup), логгеру нужны только часовые и суточные
+typedef enum {
+    ROLLUP_HOUR,   // границы по местному времени, как у меток в логах
+    ROLLUP_DAY,
+    ROLLUP_RESOLUTION_COUNT
+} RollupResolution;
+
+// Накопитель: среднее и M2 по Уэлфорду, дисперсия = m2 / count
+typedef struct {
+    unsigned long long count;
+    double sum;
+    double min;
+    double max;
+    double mean;
+    double m2;
+} RollupAccumulator;
+
+typedef struct {
+    RollupResolution resolution;
+    uint16_t sensorId;
+    time_t start;  // [start, end); start == end - корзина отдана по времени и закрыта
+    time_t end;
+    RollupAccumulator stats;
+} RollupBucket;
+
+typedef void (*RollupEmit)(void *context, const RollupBucket *bucket);
+
+typedef struct {
+    uint16_t sensorId;
+    RollupBucket buckets[ROLLUP_RESOLUTION_COUNT];
+} RollupSeries;
+
+// Текущие корзины каждого датчика; законченные корзины отдаются в emit
+typedef struct {
+    RollupSeries *series;
+    size_t seriesCount;
+    size_t seriesCapacity;
+    size_t lastSeries;
+    int graceSeconds;
+    RollupEmit emit;
+    void *context;
+    unsigned long long lateSamples;  // отсчёты для уже отданных или закрытых корзин, отброшены
+    unsigned long long emitted;
+} RollupEngine;
+
+void RollupAccumulatorReset(RollupAccumulator *accumulator);
+
+void RollupAccumulatorAdd(RollupAccumulator *accumulator, double value);
+
+double RollupAccumulatorStdDev(const RollupAccumulator *accumulator);
+
+void RollupBucketBounds(RollupResolution resolution, time_t timestamp, time_t *start, time_t *end);
+
+void RollupEngineInit(RollupEngine *engine, RollupEmit emit, void *context);
+
+void RollupEngineAdd(RollupEngine *engine, uint16_t sensorId, time_t timestamp, double value);
+
+// Отдаёт корзины, закончившиеся к now (с учётом graceSeconds), даже если новых отсчётов нет
+void RollupEngineAdvance(RollupEngine *engine, time_t now);
+
+// Сохраняет незаконченные и закрытые корзины во временный файл и атомарно переименовывает его в path
+bool RollupEngineSave(const RollupEngine *engine, const char *path);
+
+// Восстанавливает корзины из контрольной точки; корзины, закончившиеся за время простоя,
+// отдаются в emit при следующем RollupEngineAdvance
+bool RollupEngineLoad(RollupEngine *engine, const char *path);
+
+void RollupEngineClose(RollupEngine *engine);
+
+#endif // ROLLUP_H
@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include <sched.h>
+
+#include "SampleQueue.h"
+
+bool SampleQueueInit(SampleQueue *queue, size_t capacity, SampleQueuePolicy policy) {
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    queue->items = (TemperatureSample *)malloc(size * sizeof(TemperatureSample));
+    if (!queue->items) return false;
+
+    queue->mask = size - 1;
+    queue->policy = policy;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->pushed, 0);
+    atomic_init(&queue->dropped, 0);
+    atomic_init(&queue->highWatermark, 0);
+    return true;
+}
+
+void SampleQueueDestroy(SampleQueue *queue) {
+    free(queue->items);
+    queue->items = NULL;
+}
+
+bool SampleQueuePush(SampleQueue *queue, const TemperatureSample *sample) {
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+    while (tail - head > queue->mask) {
+        if (queue->policy == SAMPLE_QUEUE_DROP_NEWEST) {
+            atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+            return false;
+        }
+        sched_yield();
+        head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    }
+
+    queue->items[tail & queue->mask] = *sample;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    atomic_fetch_add_explicit(&queue->pushed, 1, memory_order_relaxed);
+
+    size_t depth = tail + 1 - head;
+    if (depth > atomic_load_explicit(&queue->highWatermark, memory_order_relaxed)) {
+        atomic_store_explicit(&queue->highWatermark, depth, memory_order_relaxed);
+    }
+    return true;
+}
+
+size_t SampleQueuePopBatch(SampleQueue *queue, TemperatureSample *samples, size_t maxCount) {
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+    size_t count = tail - head;
+    if (count > maxCount) count = maxCount;
+
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = queue->items[(head + i) & queue->mask];
+    }
+    atomic_store_explicit(&queue->head, head + count, memory_order_release);
+    return count;
+}
+
+bool SampleQueueEmpty(SampleQueue *queue) {
+    return atomic_load(&queue->head) == atomic_load(&queue->tail);
+}
+
+void SampleQueueGetStats(SampleQueue *queue, SampleQueueStats *stats) {
+    stats->depth = atomic_load(&queue->tail) - atomic_load(&queue->head);
+    stats->capacity = queue->mask + 1;
+    stats->highWatermark = atomic_load(&queue->highWatermark);
+    stats->pushed = atomic_load(&queue->pushed);
+    stats->dropped = atomic_load(&queue->dropped);
+}
@@ -0,0 +1,57 @@
+#ifndef SAMPLE_QUEUE_H
+#define SAMPLE_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define SAMPLE_QUEUE_CACHE_LINE 64
+
+typedef struct {
+    int64_t timestampMs;  // время приёма, мс от эпохи
+    uint16_t sensorId;
+    double temperature;
+} TemperatureSample;
+
+typedef enum {
+    SAMPLE_QUEUE_DROP_NEWEST,  // очередь полна - отсчёт отбрасывается и считается
+    SAMPLE_QUEUE_BLOCK         // очередь полна - читатель ждёт, пока сток освободит место
+} SampleQueuePolicy;
+
+// Ограниченное кольцо без блокировок для одного писателя и одного читателя.
+// Ёмкость округляется вверх до степени двойки.
+typedef struct {
+    _Alignas(SAMPLE_QUEUE_CACHE_LINE) atomic_size_t head;  // пишет только читатель
+    _Alignas(SAMPLE_QUEUE_CACHE_LINE) atomic_size_t tail;  // пишет только писатель
+    _Alignas(SAMPLE_QUEUE_CACHE_LINE) TemperatureSample *items;
+    size_t mask;
+    SampleQueuePolicy policy;
+    atomic_ullong pushed;
+    atomic_ullong dropped;
+    atomic_size_t highWatermark;
+} SampleQueue;
+
+typedef struct {
+    size_t depth;
+    size_t capacity;
+    size_t highWatermark;
+    unsigned long long pushed;
+    unsigned long long dropped;
+} SampleQueueStats;
+
+bool SampleQueueInit(SampleQueue *queue, size_t capacity, SampleQueuePolicy policy);
+
+void SampleQueueDestroy(SampleQueue *queue);
+
+// Сторона писателя. Возвращает false, если отсчёт отброшен.
+bool SampleQueuePush(SampleQueue *queue, const TemperatureSample *sample);
+
+// Сторона читателя: забирает до maxCount отсчётов за раз.
+size_t SampleQueuePopBatch(SampleQueue *queue, TemperatureSample *samples, size_t maxCount);
+
+bool SampleQueueEmpty(SampleQueue *queue);
+
+void SampleQueueGetStats(SampleQueue *queue, SampleQueueStats *stats);
+
+#endif // SAMPLE_QUEUE_H
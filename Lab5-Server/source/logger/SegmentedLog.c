@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "SegmentedLog.h"
+#include "LogRetention.h"
+
+static void localTime(time_t timestamp, struct tm *local) {
+#ifdef _WIN32
+    localtime_s(local, &timestamp);
+#else
+    localtime_r(&timestamp, local);
+#endif
+}
+
+static time_t periodStart(LogSegmentPeriod period, time_t timestamp) {
+    struct tm local;
+    localTime(timestamp, &local);
+
+    local.tm_min = local.tm_sec = 0;
+    if (period != LOG_SEGMENT_HOURLY) local.tm_hour = 0;
+    if (period == LOG_SEGMENT_MONTHLY) local.tm_mday = 1;
+    local.tm_isdst = -1;
+    return mktime(&local);
+}
+
+static time_t periodEnd(LogSegmentPeriod period, time_t start) {
+    struct tm local;
+    localTime(start, &local);
+
+    switch (period) {
+        case LOG_SEGMENT_HOURLY:  local.tm_hour++; break;
+        case LOG_SEGMENT_DAILY:   local.tm_mday++; break;
+        case LOG_SEGMENT_MONTHLY: local.tm_mon++;  break;
+    }
+    local.tm_isdst = -1;
+
+    // При переводе часов mktime может вернуть тот же час
+    time_t end = mktime(&local);
+    return (end > start) ? end : start + 3600;
+}
+
+static void segmentPath(const SegmentedLog *log, time_t start, unsigned splitIndex, char *path) {
+    static const char *labelFormats[] = { "%Y-%m-%d_%H", "%Y-%m-%d", "%Y-%m" };
+
+    struct tm local;
+    localTime(start, &local);
+    char label[32];
+    strftime(label, sizeof(label), labelFormats[log->period], &local);
+
+    // TemperatureLog.txt -> TemperatureLog.<label>[.<n>].txt
+    const char *base = log->basePath;
+    const char *extension = strrchr(base, '.');
+    const char *separator = strrchr(base, '/');
+    if (!separator) separator = strrchr(base, '\\');
+    if (!extension || (separator && extension < separator)) {
+        extension = base + strlen(base);
+    }
+    int stemLength = (int)(extension - base);
+
+    if (splitIndex > 0) {
+        snprintf(path, SEGMENTED_LOG_PATH_SIZE, "%.*s.%s.%u%s", stemLength, base, label, splitIndex, extension);
+    } else {
+        snprintf(path, SEGMENTED_LOG_PATH_SIZE, "%.*s.%s%s", stemLength, base, label, extension);
+    }
+}
+
+static bool appendSegment(SegmentedLog *log, time_t start, time_t end, const char *path) {
+    if (log->segmentCount == log->segmentCapacity) {
+        size_t capacity = log->segmentCapacity ? log->segmentCapacity * 2 : 64;
+        LogSegment *segments = (LogSegment *)realloc(log->segments, capacity * sizeof(LogSegment));
+        if (!segments) return false;
+        log->segments = segments;
+        log->segmentCapacity = capacity;
+    }
+
+    LogSegment *segment = &log->segments[log->segmentCount++];
+    segment->start = start;
+    segment->end = end;
+    strncpy(segment->path, path, sizeof(segment->path) - 1);
+    segment->path[sizeof(segment->path) - 1] = '\0';
+    return true;
+}
+
+static void loadManifest(SegmentedLog *log) {
+    FILE *file = fopen(log->manifestPath, "r");
+    if (!file) return;
+
+    long long start, end;
+    char path[SEGMENTED_LOG_PATH_SIZE];
+    char line[SEGMENTED_LOG_PATH_SIZE + 64];
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "%lld %lld %287[^\n]", &start, &end, path) == 3) {
+            appendSegment(log, (time_t)start, (time_t)end, path);
+        }
+    }
+    fclose(file);
+}
+
+// Манифест переписывается целиком через временный файл, чтобы не остаться обрезанным
+static bool saveManifest(const SegmentedLog *log) {
+    char temporaryPath[SEGMENTED_LOG_PATH_SIZE + 8];
+    snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", log->manifestPath);
+
+    FILE *file = fopen(temporaryPath, "w");
+    if (!file) return false;
+
+    for (size_t i = 0; i < log->segmentCount; i++) {
+        const LogSegment *segment = &log->segments[i];
+        fprintf(file, "%lld %lld %s\n", (long long)segment->start, (long long)segment->end, segment->path);
+    }
+    if (fclose(file) != 0) {
+        remove(temporaryPath);
+        return false;
+    }
+
+#ifdef _WIN32
+    remove(log->manifestPath);
+#endif
+    return rename(temporaryPath, log->manifestPath) == 0;
+}
+
+static bool openCurrentSegment(SegmentedLog *log) {
+    const LogSegment *segment = &log->segments[log->segmentCount - 1];
+    if (!LogFileOpen(&log->current, segment->path, "a", &log->policy)) {
+        fprintf(stderr, "Ошибка: не удалось открыть сегмент лога %s\n", segment->path);
+        return false;
+    }
+
+    fseek(log->current.file, 0, SEEK_END);
+    long size = ftell(log->current.file);
+    log->currentBytes = (size > 0) ? (unsigned long long)size : 0;
+    return true;
+}
+
+// split - сегмент текущего периода переполнен по размеру, продолжаем в следующий файл того же периода
+static bool rotate(SegmentedLog *log, time_t timestamp, bool split) {
+    LogFileClose(&log->current);
+
+    time_t start = periodStart(log->period, timestamp);
+    time_t end = periodEnd(log->period, start);
+    char path[SEGMENTED_LOG_PATH_SIZE];
+
+    if (split) {
+        log->segments[log->segmentCount - 1].end = timestamp + 1;
+        segmentPath(log, start, ++log->splitIndex, path);
+        start = timestamp;
+    } else {
+        log->splitIndex = 0;
+        segmentPath(log, start, 0, path);
+    }
+
+    if (!appendSegment(log, start, end, path) || !saveManifest(log)) {
+        perror("Ошибка обновления манифеста лога.\n");
+    }
+    return openCurrentSegment(log);
+}
+
+bool SegmentedLogOpen(SegmentedLog *log, const char *basePath, LogSegmentPeriod period, const LogFlushPolicy *policy) {
+    memset(log, 0, sizeof(*log));
+    strncpy(log->basePath, basePath, sizeof(log->basePath) - 1);
+    snprintf(log->manifestPath, sizeof(log->manifestPath), "%s.manifest", basePath);
+    log->period = period;
+    log->policy = policy ? *policy : LogFlushPolicyDefault();
+
+    loadManifest(log);
+
+    // После перезапуска в том же периоде дописываем последний сегмент вместо нового файла
+    time_t now = time(NULL);
+    time_t start = periodStart(period, now);
+    time_t end = periodEnd(period, start);
+    if (log->segmentCount > 0) {
+        const LogSegment *last = &log->segments[log->segmentCount - 1];
+        if (last->end > start && last->start < end) {
+            for (size_t i = log->segmentCount - 1; i > 0 && log->segments[i - 1].end > start; i--) {
+                log->splitIndex++;
+            }
+            return openCurrentSegment(log);
+        }
+    }
+    return rotate(log, now, false);
+}
+
+bool SegmentedLogLoad(SegmentedLog *log, const char *basePath) {
+    memset(log, 0, sizeof(*log));
+    strncpy(log->basePath, basePath, sizeof(log->basePath) - 1);
+    snprintf(log->manifestPath, sizeof(log->manifestPath), "%s.manifest", basePath);
+
+    loadManifest(log);
+    return log->segmentCount > 0;
+}
+
+void SegmentedLogWriteLine(SegmentedLog *log, time_t timestamp, const char *line) {
+    if (log->segmentCount == 0) return;
+
+    LogSegment *current = &log->segments[log->segmentCount - 1];
+    if (timestamp >= current->end) {
+        rotate(log, timestamp, false);
+    } else if (log->maxSegmentBytes > 0 && log->currentBytes >= log->maxSegmentBytes) {
+        rotate(log, timestamp, true);
+    } else if (timestamp < current->start) {
+        current->start = timestamp;  // запоздавший отсчёт; манифест обновится при следующей ротации
+    }
+
+    LogFileWriteLine(&log->current, line);
+    log->currentBytes += strlen(line) + 1;
+}
+
+void SegmentedLogTick(SegmentedLog *log) {
+    LogFileTick(&log->current);
+}
+
+void SegmentedLogFlush(SegmentedLog *log) {
+    LogFileFlush(&log->current);
+}
+
+bool SegmentedLogSync(SegmentedLog *log) {
+    return LogFileSync(&log->current);
+}
+
+size_t SegmentedLogRetain(SegmentedLog *log, time_t cutoff) {
+    size_t removed = 0;
+
+    // Текущий сегмент не удаляется, даже если он целиком старше cutoff
+    while (removed + 1 < log->segmentCount && log->segments[removed].end <= cutoff) {
+        if (remove(log->segments[removed].path) != 0 && errno != ENOENT) {
+            fprintf(stderr, "Ошибка: не удалось удалить сегмент лога %s\n", log->segments[removed].path);
+            break;
+        }
+        removed++;
+    }
+
+    log->segmentCount -= removed;
+    memmove(log->segments, log->segments + removed, log->segmentCount * sizeof(LogSegment));
+    log->segmentsRemoved += removed;
+
+    // Сегмент, на который пришёлся cutoff, обрезается по записям: иначе месячный сегмент
+    // суточных средних держал бы до месяца данных сверх срока хранения
+    bool trimmed = false;
+    if (log->segmentCount > 0 && log->segments[0].start < cutoff && log->segments[0].end > cutoff) {
+        LogSegment *oldest = &log->segments[0];
+        bool current = log->segmentCount == 1;
+        trimmed = current ? LogFileRetain(&log->current, cutoff) : LogRetentionApply(oldest->path, cutoff);
+        if (trimmed) {
+            oldest->start = cutoff;
+            if (current) {
+                log->currentBytes = (unsigned long long)ftell(log->current.file);
+            }
+        } else {
+            fprintf(stderr, "Ошибка: не удалось обрезать сегмент лога %s\n", oldest->path);
+        }
+    }
+    if (removed == 0 && !trimmed) return 0;
+
+    if (!saveManifest(log)) {
+        perror("Ошибка обновления манифеста лога.\n");
+    }
+    return removed;
+}
+
+size_t SegmentedLogSelect(const SegmentedLog *log, time_t from, time_t to, const LogSegment **first) {
+    size_t begin = 0;
+    while (begin < log->segmentCount && log->segments[begin].end <= from) {
+        begin++;
+    }
+
+    size_t end = begin;
+    while (end < log->segmentCount && log->segments[end].start < to) {
+        end++;
+    }
+
+    *first = log->segments + begin;
+    return end - begin;
+}
+
+void SegmentedLogClose(SegmentedLog *log) {
+    // Загруженный SegmentedLogLoad лог только читался - манифест не переписываем
+    bool opened = log->current.file != NULL;
+    LogFileClose(&log->current);
+    if (opened && log->segmentCount > 0 && !saveManifest(log)) {
+        perror("Ошибка обновления манифеста лога.\n");
+    }
+    free(log->segments);
+    log->segments = NULL;
+    log->segmentCount = log->segmentCapacity = 0;
+}
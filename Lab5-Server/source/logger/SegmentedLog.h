@@ -0,0 +1,69 @@
+#ifndef SEGMENTED_LOG_H
+#define SEGMENTED_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "LogFile.h"
+
+#define SEGMENTED_LOG_PATH_SIZE 288
+
+typedef enum {
+    LOG_SEGMENT_HOURLY,   // TemperatureLog.2024-05-01_13.txt
+    LOG_SEGMENT_DAILY,    // TemperatureLog.2024-05-01.txt
+    LOG_SEGMENT_MONTHLY   // TemperatureLog.2024-05.txt
+} LogSegmentPeriod;
+
+// Записи со временем в [start, end)
+typedef struct {
+    time_t start;
+    time_t end;
+    char path[SEGMENTED_LOG_PATH_SIZE];
+} LogSegment;
+
+// Лог из файлов-сегментов по периодам с манифестом "<basePath>.manifest" (строки "start end path").
+// Очистка старых данных - удаление целых сегментов, после перезапуска запись продолжается в текущий сегмент.
+typedef struct {
+    char basePath[256];
+    char manifestPath[SEGMENTED_LOG_PATH_SIZE];
+    LogSegmentPeriod period;
+    size_t maxSegmentBytes;  // > 0 - дополнительно делить сегмент по размеру; можно менять после открытия
+    LogFlushPolicy policy;
+
+    LogFile current;
+    unsigned long long currentBytes;
+    unsigned splitIndex;
+
+    LogSegment *segments;    // по возрастанию start, последний - текущий
+    size_t segmentCount;
+    size_t segmentCapacity;
+    unsigned long long segmentsRemoved;
+} SegmentedLog;
+
+bool SegmentedLogOpen(SegmentedLog *log, const char *basePath, LogSegmentPeriod period, const LogFlushPolicy *policy);
+
+// Только читает манифест, не открывая сегментов для записи (например, в другом процессе, пока
+// лог пишется). false - манифеста нет или он пуст. Освобождается SegmentedLogClose.
+bool SegmentedLogLoad(SegmentedLog *log, const char *basePath);
+
+// timestamp - время записи, по нему выбирается сегмент
+void SegmentedLogWriteLine(SegmentedLog *log, time_t timestamp, const char *line);
+
+void SegmentedLogTick(SegmentedLog *log);
+
+void SegmentedLogFlush(SegmentedLog *log);
+
+// Закрытые сегменты уже на диске, синхронизируется только текущий
+bool SegmentedLogSync(SegmentedLog *log);
+
+// Удаляет сегменты, целиком лежащие раньше cutoff, а из сегмента, на который приходится cutoff,
+// вырезает записи старше него (LogRetentionApply). Возвращает число удалённых сегментов.
+size_t SegmentedLogRetain(SegmentedLog *log, time_t cutoff);
+
+// Сегменты, пересекающиеся с [from, to): *first - первый из них, возвращается их число
+size_t SegmentedLogSelect(const SegmentedLog *log, time_t from, time_t to, const LogSegment **first);
+
+void SegmentedLogClose(SegmentedLog *log);
+
+#endif // SEGMENTED_LOG_H
@@ -0,0 +1,31 @@
+#ifndef SENSOR_FRAME_H
+#define SENSOR_FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Бинарный кадр: sync | sensorId (2) | timestampMs (2) | value (2, сотые доли градуса) | CRC-8.
+// Многобайтовые поля передаются в little-endian, CRC считается по всем байтам после sync.
+#define SENSOR_FRAME_SYNC  0xA5
+#define SENSOR_FRAME_SIZE  8
+#define SENSOR_FRAME_SCALE 100.0
+
+typedef enum {
+    SENSOR_PROTOCOL_TEXT,
+    SENSOR_PROTOCOL_BINARY
+} SensorProtocol;
+
+typedef struct {
+    uint16_t sensorId;
+    uint16_t timestampMs;  // счётчик миллисекунд устройства, переполняется каждые 65.5 с
+    double temperature;
+} SensorFrame;
+
+uint8_t SensorFrameCrc8(const uint8_t *data, size_t length);
+
+void SensorFrameEncode(const SensorFrame *frame, uint8_t *buffer);
+
+bool SensorFrameDecode(const uint8_t *buffer, SensorFrame *frame);
+
+#endif // SENSOR_FRAME_H
@@ -0,0 +1,93 @@
+#include "SerialFramer.h"
+
+void SerialFramerInit(SerialFramer *framer) {
+    framer->head = 0;
+    framer->tail = 0;
+    framer->discarding = false;
+    framer->frames = 0;
+    framer->malformedFrames = 0;
+    framer->droppedFrames = 0;
+    framer->data[0] = '\0';
+}
+
+int SerialFramerFill(SerialFramer *framer, SerialPort *serial) {
+    if (framer->head == framer->tail) {
+        framer->head = framer->tail = 0;
+    }
+
+    if (framer->tail == SERIAL_FRAMER_CAPACITY) {
+        if (framer->head > 0) {
+            // Переносим в начало только недочитанный хвост последней строки
+            memmove(framer->data, framer->data + framer->head, framer->tail - framer->head);
+            framer->tail -= framer->head;
+            framer->head = 0;
+        } else {
+            // Строка не помещается в буфер целиком - отбрасываем её до следующего '\n'
+            if (!framer->discarding) {
+                framer->droppedFrames++;
+                framer->discarding = true;
+            }
+            framer->head = framer->tail = 0;
+        }
+    }
+
+    int bytesRead = SerialRead(serial, framer->data + framer->tail, SERIAL_FRAMER_CAPACITY - framer->tail + 1);
+    if (bytesRead > 0) {
+        framer->tail += bytesRead;
+    }
+    return bytesRead;
+}
+
+bool SerialFramerNextLine(SerialFramer *framer, const char **line, size_t *length) {
+    while (framer->head < framer->tail) {
+        char *start = framer->data + framer->head;
+        char *newline = memchr(start, '\n', framer->tail - framer->head);
+        if (!newline) {
+            return false;
+        }
+
+        size_t lineLength = newline - start;
+        framer->head += lineLength + 1;
+
+        if (framer->discarding) {
+            framer->discarding = false;
+            continue;
+        }
+
+        if (lineLength > 0 && start[lineLength - 1] == '\r') {
+            lineLength--;
+        }
+        if (lineLength == 0) {
+            continue;
+        }
+
+        framer->frames++;
+        *line = start;
+        *length = lineLength;
+        return true;
+    }
+    return false;
+}
+
+bool SerialFramerNextFrame(SerialFramer *framer, SensorFrame *frame) {
+    while (framer->tail - framer->head >= SENSOR_FRAME_SIZE) {
+        const uint8_t *start = (const uint8_t *)framer->data + framer->head;
+        if (*start != SENSOR_FRAME_SYNC) {
+            const uint8_t *sync = memchr(start, SENSOR_FRAME_SYNC, framer->tail - framer->head);
+            framer->head = sync ? (size_t)((const char *)sync - framer->data) : framer->tail;
+            continue;
+        }
+
+        if (!SensorFrameDecode(start, frame)) {
+            // Ложный sync или повреждённый кадр - сдвигаемся на байт и ищем заново
+            framer->malformedFrames++;
+            framer->head++;
+            continue;
+        }
+
+        framer->head += SENSOR_FRAME_SIZE;
+        framer->frames++;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,35 @@
+#ifndef SERIAL_FRAMER_H
+#define SERIAL_FRAMER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "SerialPort.h"
+#include "SensorFrame.h"
+
+#define SERIAL_FRAMER_CAPACITY 4096
+
+// Кольцевой буфер приёма над SerialRead: данные читаются прямо в буфер,
+// а кадры (строки) отдаются указателями на него без копирования.
+typedef struct {
+    char data[SERIAL_FRAMER_CAPACITY + 1];
+    size_t head;
+    size_t tail;
+    bool discarding;
+    unsigned long frames;
+    unsigned long malformedFrames;
+    unsigned long droppedFrames;
+} SerialFramer;
+
+void SerialFramerInit(SerialFramer *framer);
+
+// Дочитывает из порта в свободное место буфера. Возвращает результат SerialRead.
+int SerialFramerFill(SerialFramer *framer, SerialPort *serial);
+
+// Отдаёт очередную полную строку без '\n'. Указатель действителен до следующего SerialFramerFill.
+bool SerialFramerNextLine(SerialFramer *framer, const char **line, size_t *length);
+
+// Отдаёт очередной бинарный кадр с верной CRC. Битые байты пропускаются до следующего sync.
+bool SerialFramerNextFrame(SerialFramer *framer, SensorFrame *frame);
+
+#endif // SERIAL_FRAMER_H
@@ -0,0 +1,139 @@
+#include "SerialPoller.h"
+
+#if defined(__linux__)
+    #include <sys/epoll.h>
+#endif
+
+typedef struct {
+    SerialPort *serial;
+    void *context;
+} SerialPollerEntry;
+
+struct SerialPoller {
+#if defined(__linux__)
+    int epollFd;
+#elif !defined(_WIN32)
+    struct pollfd *pollFds;
+#endif
+    SerialPollerEntry *entries;
+    size_t count;
+    size_t capacity;
+};
+
+SerialPoller* SerialPollerInit(size_t capacity) {
+    SerialPoller *poller = (SerialPoller *)calloc(1, sizeof(SerialPoller));
+    if (!poller) return NULL;
+
+    poller->capacity = capacity;
+    poller->entries = (SerialPollerEntry *)calloc(capacity, sizeof(SerialPollerEntry));
+    if (!poller->entries) {
+        free(poller);
+        return NULL;
+    }
+
+#if defined(__linux__)
+    poller->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (poller->epollFd == -1) {
+        free(poller->entries);
+        free(poller);
+        return NULL;
+    }
+#elif !defined(_WIN32)
+    poller->pollFds = (struct pollfd *)calloc(capacity, sizeof(struct pollfd));
+    if (!poller->pollFds) {
+        free(poller->entries);
+        free(poller);
+        return NULL;
+    }
+#endif
+
+    return poller;
+}
+
+void SerialPollerClose(SerialPoller *poller) {
+    if (!poller) return;
+
+#if defined(__linux__)
+    close(poller->epollFd);
+#elif !defined(_WIN32)
+    free(poller->pollFds);
+#endif
+    free(poller->entries);
+    free(poller);
+}
+
+bool SerialPollerAdd(SerialPoller *poller, SerialPort *serial, void *context) {
+    if (!poller || !serial || poller->count == poller->capacity) return false;
+
+#if defined(__linux__)
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = context };
+    if (epoll_ctl(poller->epollFd, EPOLL_CTL_ADD, serial->fd, &event) == -1) {
+        return false;
+    }
+#elif !defined(_WIN32)
+    poller->pollFds[poller->count].fd = serial->fd;
+    poller->pollFds[poller->count].events = POLLIN;
+#endif
+
+    poller->entries[poller->count].serial = serial;
+    poller->entries[poller->count].context = context;
+    poller->count++;
+    return true;
+}
+
+void SerialPollerRemove(SerialPoller *poller, SerialPort *serial) {
+    if (!poller || !serial) return;
+
+    for (size_t i = 0; i < poller->count; i++) {
+        if (poller->entries[i].serial != serial) continue;
+
+#if defined(__linux__)
+        epoll_ctl(poller->epollFd, EPOLL_CTL_DEL, serial->fd, NULL);
+#elif !defined(_WIN32)
+        poller->pollFds[i] = poller->pollFds[poller->count - 1];
+#endif
+        poller->entries[i] = poller->entries[poller->count - 1];
+        poller->count--;
+        return;
+    }
+}
+
+int SerialPollerWait(SerialPoller *poller, void **readyContexts, size_t maxReady, int timeoutMs) {
+    if (!poller) return -1;
+
+#if defined(__linux__)
+    struct epoll_event events[SERIAL_POLLER_MAX_EVENTS];
+    if (maxReady > SERIAL_POLLER_MAX_EVENTS) {
+        maxReady = SERIAL_POLLER_MAX_EVENTS;
+    }
+
+    int result = epoll_wait(poller->epollFd, events, (int)maxReady, timeoutMs);
+    if (result < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+    for (int i = 0; i < result; i++) {
+        readyContexts[i] = events[i].data.ptr;
+    }
+    return result;
+#elif !defined(_WIN32)
+    int result = poll(poller->pollFds, poller->count, timeoutMs);
+    if (result <= 0) {
+        return (result < 0 && errno != EINTR) ? -1 : 0;
+    }
+
+    int ready = 0;
+    for (size_t i = 0; i < poller->count && (size_t)ready < maxReady; i++) {
+        if (poller->pollFds[i].revents) {
+            readyContexts[ready++] = poller->entries[i].context;
+        }
+    }
+    return ready;
+#else
+    (void)timeoutMs;
+    int ready = 0;
+    for (size_t i = 0; i < poller->count && (size_t)ready < maxReady; i++) {
+        readyContexts[ready++] = poller->entries[i].context;
+    }
+    return ready;
+#endif
+}
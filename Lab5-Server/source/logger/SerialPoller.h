@@ -0,0 +1,26 @@
+#ifndef SERIAL_POLLER_H
+#define SERIAL_POLLER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "SerialPort.h"
+
+#define SERIAL_POLLER_MAX_EVENTS 64
+
+// Ожидание данных сразу на многих портах: epoll на Linux, poll на остальных POSIX-системах.
+// На Windows ReadFile блокируется сам, поэтому все порты считаются готовыми.
+typedef struct SerialPoller SerialPoller;
+
+SerialPoller* SerialPollerInit(size_t capacity);
+
+void SerialPollerClose(SerialPoller *poller);
+
+bool SerialPollerAdd(SerialPoller *poller, SerialPort *serial, void *context);
+
+void SerialPollerRemove(SerialPoller *poller, SerialPort *serial);
+
+// Заполняет readyContexts контекстами готовых портов. Возвращает их число, 0 по таймауту, -1 при ошибке.
+int SerialPollerWait(SerialPoller *poller, void **readyContexts, size_t maxReady, int timeoutMs);
+
+#endif // SERIAL_POLLER_H
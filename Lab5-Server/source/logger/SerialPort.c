@@ -1,11 +1,53 @@
 #include "SerialPort.h"
 
-SerialPort* SerialOpen(const char *portName, int baudRate) {
+#ifndef _WIN32
+    #include <pty.h>
+#endif
+
+#ifndef _WIN32
+struct SerialChannel {
+    pthread_mutex_t mutex;
+    pthread_cond_t notFull;
+    char *data;
+    size_t capacity;
+    size_t head;
+    size_t size;
+    int notifyFds[2];
+    int references;
+    bool closed;
+};
+
+static void configureTerminal(int fd, int baudRate) {
+    struct termios options;
+    tcgetattr(fd, &options);
+
+    cfsetispeed(&options, baudRate);
+    cfsetospeed(&options, baudRate);
+
+    options.c_cflag = CS8 | CLOCAL | CREAD;
+    options.c_iflag = IGNPAR;
+    options.c_oflag = 0;
+    options.c_lflag = 0;
+
+    tcflush(fd, TCIFLUSH);
+    tcsetattr(fd, TCSANOW, &options);
+}
+#endif
+
+static SerialPort* allocatePort(const char *portName) {
     SerialPort *serial = (SerialPort*)malloc(sizeof(SerialPort));
     if (!serial) return NULL;
 
     strncpy(serial->portName, portName, sizeof(serial->portName) - 1);
     serial->portName[sizeof(serial->portName) - 1] = '\0';
+    serial->backend = SERIAL_BACKEND_DEVICE;
+    serial->channel = NULL;
+    return serial;
+}
+
+SerialPort* SerialOpen(const char *portName, int baudRate) {
+    SerialPort *serial = allocatePort(portName);
+    if (!serial) return NULL;
 
 #ifdef _WIN32
     serial->handle = CreateFile(portName, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
@@ -52,31 +94,190 @@ SerialPort* SerialOpen(const char *portName, int baudRate) {
         return NULL;
     }
 
-    struct termios options;
-    tcgetattr(serial->fd, &options);
+    configureTerminal(serial->fd, baudRate);
+#endif
 
-    cfsetispeed(&options, baudRate);
-    cfsetospeed(&options, baudRate);
+    return serial;
+}
 
-    options.c_cflag = CS8 | CLOCAL | CREAD;
-    options.c_iflag = IGNPAR;
-    options.c_oflag = 0;
-    options.c_lflag = 0;
+bool SerialOpenPtyPair(int baudRate, SerialPort **master, SerialPort **slave) {
+#ifdef _WIN32
+    (void)baudRate;
+    *master = *slave = NULL;
+    return false;
+#else
+    int masterFd, slaveFd;
+    char slaveName[64];
+    if (openpty(&masterFd, &slaveFd, slaveName, NULL, NULL) == -1) {
+        return false;
+    }
+
+    *master = allocatePort("/dev/ptmx");
+    *slave = allocatePort(slaveName);
+    if (!*master || !*slave) {
+        free(*master);
+        free(*slave);
+        close(masterFd);
+        close(slaveFd);
+        return false;
+    }
+
+    configureTerminal(slaveFd, baudRate);
+    fcntl(masterFd, F_SETFL, fcntl(masterFd, F_GETFL) | O_NONBLOCK);
+    fcntl(slaveFd, F_SETFL, fcntl(slaveFd, F_GETFL) | O_NONBLOCK);
+
+    (*master)->fd = masterFd;
+    (*slave)->fd = slaveFd;
+    return true;
+#endif
+}
+
+bool SerialOpenMemoryChannel(size_t capacity, SerialPort **writer, SerialPort **reader) {
+#ifdef _WIN32
+    (void)capacity;
+    *writer = *reader = NULL;
+    return false;
+#else
+    SerialChannel *channel = (SerialChannel *)calloc(1, sizeof(SerialChannel));
+    if (!channel) return false;
 
-    tcflush(serial->fd, TCIFLUSH);
-    tcsetattr(serial->fd, TCSANOW, &options);
+    channel->data = (char *)malloc(capacity);
+    if (!channel->data || pipe(channel->notifyFds) == -1) {
+        free(channel->data);
+        free(channel);
+        return false;
+    }
+    fcntl(channel->notifyFds[0], F_SETFL, O_NONBLOCK);
+    channel->capacity = capacity;
+    channel->references = 2;
+    pthread_mutex_init(&channel->mutex, NULL);
+    pthread_cond_init(&channel->notFull, NULL);
+
+    *writer = allocatePort("memory:writer");
+    *reader = allocatePort("memory:reader");
+    if (!*writer || !*reader) {
+        free(*writer);
+        free(*reader);
+        close(channel->notifyFds[0]);
+        close(channel->notifyFds[1]);
+        free(channel->data);
+        free(channel);
+        return false;
+    }
+
+    (*writer)->backend = (*reader)->backend = SERIAL_BACKEND_MEMORY;
+    (*writer)->channel = (*reader)->channel = channel;
+    (*writer)->fd = channel->notifyFds[1];
+    (*reader)->fd = channel->notifyFds[0];
+    return true;
 #endif
+}
 
-    return serial;
+#ifndef _WIN32
+// Байт в notifyFds есть ровно тогда, когда канал не пуст или закрыт. Вызывать под mutex.
+static void channelNotify(SerialChannel *channel) {
+    char signal = 1;
+    if (write(channel->notifyFds[1], &signal, 1) < 0) {
+        perror("Ошибка уведомления канала.\n");
+    }
+}
+
+static void channelClose(SerialChannel *channel) {
+    pthread_mutex_lock(&channel->mutex);
+    if (!channel->closed) {
+        channel->closed = true;
+        if (channel->size == 0) {
+            channelNotify(channel);
+        }
+        pthread_cond_broadcast(&channel->notFull);
+    }
+    bool last = --channel->references == 0;
+    pthread_mutex_unlock(&channel->mutex);
+
+    if (last) {
+        close(channel->notifyFds[0]);
+        close(channel->notifyFds[1]);
+        pthread_cond_destroy(&channel->notFull);
+        pthread_mutex_destroy(&channel->mutex);
+        free(channel->data);
+        free(channel);
+    }
 }
 
+static int channelWrite(SerialChannel *channel, const char *data, size_t length) {
+    size_t written = 0;
+
+    pthread_mutex_lock(&channel->mutex);
+    while (written < length) {
+        // Пишущий конец блокируется при заполнении, чтобы замеры не теряли данные
+        while (channel->size == channel->capacity && !channel->closed) {
+            pthread_cond_wait(&channel->notFull, &channel->mutex);
+        }
+        if (channel->closed) {
+            pthread_mutex_unlock(&channel->mutex);
+            errno = EPIPE;
+            return -1;
+        }
+
+        size_t tail = (channel->head + channel->size) % channel->capacity;
+        size_t chunk = channel->capacity - channel->size;
+        if (chunk > channel->capacity - tail) chunk = channel->capacity - tail;
+        if (chunk > length - written) chunk = length - written;
+
+        memcpy(channel->data + tail, data + written, chunk);
+        if (channel->size == 0) {
+            channelNotify(channel);
+        }
+        channel->size += chunk;
+        written += chunk;
+    }
+    pthread_mutex_unlock(&channel->mutex);
+
+    return (int)written;
+}
+
+static int channelRead(SerialChannel *channel, char *buffer, size_t length) {
+    pthread_mutex_lock(&channel->mutex);
+    size_t total = (length < channel->size) ? length : channel->size;
+    size_t first = channel->capacity - channel->head;
+    if (first > total) first = total;
+
+    memcpy(buffer, channel->data + channel->head, first);
+    memcpy(buffer + first, channel->data, total - first);
+    channel->head = (channel->head + total) % channel->capacity;
+    channel->size -= total;
+
+    if (total > 0) {
+        pthread_cond_signal(&channel->notFull);
+        if (channel->size == 0 && !channel->closed) {
+            char signal;
+            if (read(channel->notifyFds[0], &signal, 1) < 0) {
+                perror("Ошибка уведомления канала.\n");
+            }
+        }
+    }
+    bool closed = channel->closed;
+    pthread_mutex_unlock(&channel->mutex);
+
+    if (total == 0 && !closed) {
+        errno = EAGAIN;
+        return -1;
+    }
+    return (int)total;
+}
+#endif
+
 void SerialClose(SerialPort *serial) {
     if (!serial) return;
 
 #ifdef _WIN32
     CloseHandle(serial->handle);
 #else
-    close(serial->fd);
+    if (serial->backend == SERIAL_BACKEND_MEMORY) {
+        channelClose(serial->channel);
+    } else {
+        close(serial->fd);
+    }
 #endif
 
     free(serial);
@@ -92,6 +293,10 @@ int SerialWrite(SerialPort *serial, const char *data, size_t length) {
     }
     return (int)bytesWritten;
 #else
+    if (serial->backend == SERIAL_BACKEND_MEMORY) {
+        return channelWrite(serial->channel, data, length);
+    }
+
     int bytesWritten = write(serial->fd, data, length);
     return (bytesWritten < 0) ? -1 : bytesWritten;
 #endif
@@ -106,12 +311,21 @@ int SerialRead(SerialPort *serial, char *buffer, size_t bufferSize) {
         buffer[bytesRead] = '\0';
         return (int)bytesRead;
     }
+    errno = EAGAIN;  // истёк таймаут чтения, как для неблокирующего fd
     return -1;
 #else
+    if (serial->backend == SERIAL_BACKEND_MEMORY) {
+        int bytesRead = channelRead(serial->channel, buffer, bufferSize - 1);
+        if (bytesRead >= 0) {
+            buffer[bytesRead] = '\0';
+        }
+        return bytesRead;
+    }
+
     int bytesRead = read(serial->fd, buffer, bufferSize - 1);
     if (bytesRead > 0) {
         buffer[bytesRead] = '\0';
     }
     return (bytesRead < 0) ? -1 : bytesRead;
 #endif
-}
\ No newline at end of file
+}
@@ -4,27 +4,48 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 
 #ifdef _WIN32
     #include <windows.h>
+    #include <errno.h>
 #else
     #include <termios.h>
     #include <unistd.h>
     #include <fcntl.h>
     #include <errno.h>
+    #include <poll.h>
+    #include <pthread.h>
 #endif
 
+#define SERIAL_CHANNEL_CAPACITY 65536
+
+typedef enum {
+    SERIAL_BACKEND_DEVICE,  // настоящий порт или псевдотерминал
+    SERIAL_BACKEND_MEMORY   // канал в памяти процесса, без TTY
+} SerialBackend;
+
+typedef struct SerialChannel SerialChannel;
+
 typedef struct {
 #ifdef _WIN32
     HANDLE handle;
 #else
-    int fd;
+    int fd;  // для канала в памяти - fd уведомлений, читаемый, пока в канале есть данные
 #endif
     char portName[20];
+    SerialBackend backend;
+    SerialChannel *channel;
 } SerialPort;
 
 SerialPort* SerialOpen(const char *portName, int baudRate);
 
+// Создаёт связанную пару псевдотерминалов: записанное в один конец читается из другого.
+bool SerialOpenPtyPair(int baudRate, SerialPort **master, SerialPort **slave);
+
+// Создаёт однонаправленный канал в памяти: writer пишет, reader читает.
+bool SerialOpenMemoryChannel(size_t capacity, SerialPort **writer, SerialPort **reader);
+
 void SerialClose(SerialPort *serial);
 
 int SerialWrite(SerialPort *serial, const char *data, size_t length);
@@ -1,39 +1,114 @@
+#include <math.h>
+
 #include "TemperatureDeviceSimulator.h"
 
-double generateRandomTemperature(double minTemperature, double maxTemperature) {
-    double range = (maxTemperature - minTemperature); 
-    double div = RAND_MAX / range;
-    return minTemperature + (rand() / div);
+double generateRandomTemperature(RandomState *random, double minTemperature, double maxTemperature) {
+    return minTemperature + RandomUniform(random) * (maxTemperature - minTemperature);
+}
+
+void TemperatureDeviceSimulatorSeed(TemperatureDeviceSimulator *temperatureDeviceSimulator, uint64_t seed) {
+    RandomSeed(&temperatureDeviceSimulator->random, seed);
+}
+
+void TemperatureDeviceSimulatorGenerate(TemperatureDeviceSimulator *temperatureDeviceSimulator, double *samples, size_t count) {
+    RandomState random = temperatureDeviceSimulator->random;
+    double temperature = temperatureDeviceSimulator->previousTemperature;
+    double minTemperature = temperatureDeviceSimulator->minTemperature;
+    double maxTemperature = temperatureDeviceSimulator->maxTemperature;
+    double alpha = temperatureDeviceSimulator->alpha;
+
+    for (size_t i = 0; i < count; i++) {
+        temperature = temperature * (1 - alpha) + generateRandomTemperature(&random, minTemperature, maxTemperature) * alpha;
+        samples[i] = temperature;
+    }
+
+    temperatureDeviceSimulator->random = random;
+    temperatureDeviceSimulator->previousTemperature = temperature;
 }
 
-double smoothedTemperature(double previousTemperature, double minTemperature, double maxTemperature, double alpha) {
-    double newTemperature = generateRandomTemperature(minTemperature, maxTemperature);
-    return previousTemperature * (1 - alpha) + newTemperature * alpha;
+static double nextTemperature(TemperatureDeviceSimulator *temperatureDeviceSimulator) {
+    double temperature;
+    TemperatureDeviceSimulatorGenerate(temperatureDeviceSimulator, &temperature, 1);
+    return temperature;
+}
+
+static uint16_t deviceTimestampMs() {
+#ifdef _WIN32
+    return (uint16_t)GetTickCount();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint16_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+#endif
+}
+
+static size_t encodeTemperature(TemperatureDeviceSimulator *temperatureDeviceSimulator, double temperature, char *buffer) {
+    if (temperatureDeviceSimulator->protocol == SENSOR_PROTOCOL_BINARY) {
+        SensorFrame frame = {
+            .sensorId = temperatureDeviceSimulator->sensorId,
+            .timestampMs = deviceTimestampMs(),
+            .temperature = temperature
+        };
+        SensorFrameEncode(&frame, (uint8_t *)buffer);
+        return SENSOR_FRAME_SIZE;
+    }
+
+    return snprintf(buffer, TEMPERATURE_BUFFER_SIZE, "%f\n", temperature);
 }
 
 TemperatureDeviceSimulator* TemperatureDeviceSimulatorInit(
     const char *portName, double baudRate, double minTemperature, double maxTemperature, double alpha, int intervalMs
     ) {
-    TemperatureDeviceSimulator *temperatureDeviceSimulator = (TemperatureDeviceSimulator *)malloc(sizeof(TemperatureDeviceSimulator));
+    SerialPort *serialPort = SerialOpen(portName, baudRate);
+    if (!serialPort) {
+        return NULL;
+    }
+
+    TemperatureDeviceSimulator *temperatureDeviceSimulator = TemperatureDeviceSimulatorInitWithPort(
+        serialPort, minTemperature, maxTemperature, alpha, intervalMs
+        );
     if (!temperatureDeviceSimulator) {
+        SerialClose(serialPort);
         return NULL;
     }
-    
+
     temperatureDeviceSimulator->portName = portName;
     temperatureDeviceSimulator->baudRate = baudRate;
+    return temperatureDeviceSimulator;
+}
+
+TemperatureDeviceSimulator* TemperatureDeviceSimulatorInitWithPort(
+    SerialPort *serialPort, double minTemperature, double maxTemperature, double alpha, int intervalMs
+    ) {
+    TemperatureDeviceSimulator *temperatureDeviceSimulator = (TemperatureDeviceSimulator *)malloc(sizeof(TemperatureDeviceSimulator));
+    if (!temperatureDeviceSimulator) {
+        return NULL;
+    }
+    
+    temperatureDeviceSimulator->serialPort = serialPort;
+    temperatureDeviceSimulator->portName = serialPort->portName;
+    temperatureDeviceSimulator->baudRate = 0;
     temperatureDeviceSimulator->minTemperature = minTemperature;
     temperatureDeviceSimulator->maxTemperature = maxTemperature;
     temperatureDeviceSimulator->alpha = alpha;
     temperatureDeviceSimulator->intervalMs = intervalMs;
     temperatureDeviceSimulator->previousTemperature = 0.0;
+    temperatureDeviceSimulator->protocol = SENSOR_PROTOCOL_TEXT;
+    temperatureDeviceSimulator->sensorId = 0;
+    temperatureDeviceSimulator->samplesPerSecond = 0.0;
+    temperatureDeviceSimulator->startNs = 0;
+    temperatureDeviceSimulator->tickNs = 0;
+    temperatureDeviceSimulator->tickIndex = 0;
+    temperatureDeviceSimulator->samplesSent = 0;
+    temperatureDeviceSimulator->wakeups = 0;
+    temperatureDeviceSimulator->jitterSumUs = 0.0;
+    temperatureDeviceSimulator->jitterSquaresUs = 0.0;
+    temperatureDeviceSimulator->jitterMaxUs = 0.0;
+    temperatureDeviceSimulator->dropWhenFull = false;
+    temperatureDeviceSimulator->pendingLength = 0;
+    temperatureDeviceSimulator->samplesDropped = 0;
 
-    temperatureDeviceSimulator->serialPort = SerialOpen(portName, baudRate);
-    if (!temperatureDeviceSimulator->serialPort) {
-        free(temperatureDeviceSimulator);
-        return NULL;
-    }
-
-    srand(time(NULL));
+    TemperatureDeviceSimulatorSeed(temperatureDeviceSimulator, (uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)temperatureDeviceSimulator);
 
     return temperatureDeviceSimulator;
 }
@@ -47,30 +122,327 @@ void TemperatureDeviceSimulatorClose(TemperatureDeviceSimulator *temperatureDevi
     }
 }
 
+// Пишет буфер целиком: неблокирующий порт может принять его частями
+static int writeAll(SerialPort *serialPort, const char *data, size_t length) {
+    size_t written = 0;
+    while (written < length) {
+        int result = SerialWrite(serialPort, data + written, length - written);
+        if (result < 0) {
+#ifdef _WIN32
+            return -1;
+#else
+            if (errno != EAGAIN) {
+                return -1;
+            }
+            struct pollfd pfd = { .fd = serialPort->fd, .events = POLLOUT };
+            poll(&pfd, 1, -1);
+            continue;
+#endif
+        }
+        written += result;
+    }
+    return (int)written;
+}
+
+#ifndef _WIN32
+long long MonotonicNowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void SleepUntilNs(long long deadlineNs) {
+    struct timespec deadline = {
+        .tv_sec = deadlineNs / 1000000000LL,
+        .tv_nsec = deadlineNs % 1000000000LL
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+    }
+}
+
+// Пишет сколько примет порт, остаток кладёт в pending. -1 - ошибка порта
+static int writeAvailable(TemperatureDeviceSimulator *temperatureDeviceSimulator, const char *data, size_t length) {
+    size_t written = 0;
+    while (written < length) {
+        int result = SerialWrite(temperatureDeviceSimulator->serialPort, data + written, length - written);
+        if (result < 0) {
+            if (errno != EAGAIN) {
+                return -1;
+            }
+            break;
+        }
+        written += result;
+    }
+
+    memmove(temperatureDeviceSimulator->pending, data + written, length - written);
+    temperatureDeviceSimulator->pendingLength = length - written;
+    return 0;
+}
+
+// Отправляет пачку из samples отсчётов; при dropWhenFull пачка за неотправленным хвостом теряется
+static int sendBurst(TemperatureDeviceSimulator *temperatureDeviceSimulator, const char *burst, size_t length, size_t samples) {
+    if (!temperatureDeviceSimulator->dropWhenFull) {
+        return writeAll(temperatureDeviceSimulator->serialPort, burst, length);
+    }
+    if (temperatureDeviceSimulator->pendingLength > 0) {
+        temperatureDeviceSimulator->samplesDropped += samples;
+        return 0;
+    }
+    return writeAvailable(temperatureDeviceSimulator, burst, length);
+}
+
+void TemperatureDeviceSimulatorStart(TemperatureDeviceSimulator *temperatureDeviceSimulator, long long nowNs) {
+    long long periodNs = (long long)(1e9 / temperatureDeviceSimulator->samplesPerSecond);
+
+    temperatureDeviceSimulator->startNs = nowNs;
+    temperatureDeviceSimulator->tickNs = periodNs > SIMULATOR_MIN_TICK_NS ? periodNs : SIMULATOR_MIN_TICK_NS;
+    temperatureDeviceSimulator->tickIndex = 0;
+    temperatureDeviceSimulator->samplesSent = 0;
+    temperatureDeviceSimulator->wakeups = 0;
+    temperatureDeviceSimulator->jitterSumUs = 0.0;
+    temperatureDeviceSimulator->jitterSquaresUs = 0.0;
+    temperatureDeviceSimulator->jitterMaxUs = 0.0;
+    temperatureDeviceSimulator->pendingLength = 0;
+    temperatureDeviceSimulator->samplesDropped = 0;
+}
+
+long long TemperatureDeviceSimulatorNextDeadline(const TemperatureDeviceSimulator *temperatureDeviceSimulator) {
+    return temperatureDeviceSimulator->startNs
+        + (long long)temperatureDeviceSimulator->tickIndex * temperatureDeviceSimulator->tickNs;
+}
+
+int TemperatureDeviceSimulatorTick(TemperatureDeviceSimulator *temperatureDeviceSimulator, long long nowNs) {
+    double lateUs = (nowNs - TemperatureDeviceSimulatorNextDeadline(temperatureDeviceSimulator)) / 1000.0;
+    if (lateUs < 0) lateUs = 0;
+    temperatureDeviceSimulator->wakeups++;
+    temperatureDeviceSimulator->jitterSumUs += lateUs;
+    temperatureDeviceSimulator->jitterSquaresUs += lateUs * lateUs;
+    if (lateUs > temperatureDeviceSimulator->jitterMaxUs) {
+        temperatureDeviceSimulator->jitterMaxUs = lateUs;
+    }
+
+    // Сколько отсчётов положено отправить к этому моменту - считаем от старта, поэтому ошибка не копится
+    long long elapsedNs = nowNs - temperatureDeviceSimulator->startNs;
+    unsigned long long due = (unsigned long long)(elapsedNs * temperatureDeviceSimulator->samplesPerSecond / 1e9) + 1;
+
+    // Сначала хвост прошлой пачки: кадр не должен разорваться чужими байтами
+    if (temperatureDeviceSimulator->pendingLength > 0 &&
+        writeAvailable(temperatureDeviceSimulator, temperatureDeviceSimulator->pending, temperatureDeviceSimulator->pendingLength) < 0) {
+        return -1;
+    }
+
+    char burst[SIMULATOR_BURST_SIZE];
+    double samples[SIMULATOR_BATCH_SIZE];
+    size_t length = 0, burstSamples = 0;
+    while (temperatureDeviceSimulator->samplesSent < due) {
+        size_t count = due - temperatureDeviceSimulator->samplesSent;
+        if (count > SIMULATOR_BATCH_SIZE) count = SIMULATOR_BATCH_SIZE;
+        TemperatureDeviceSimulatorGenerate(temperatureDeviceSimulator, samples, count);
+
+        for (size_t i = 0; i < count; i++) {
+            if (length + TEMPERATURE_BUFFER_SIZE > sizeof(burst)) {
+                if (sendBurst(temperatureDeviceSimulator, burst, length, burstSamples) < 0) {
+                    return -1;
+                }
+                length = 0;
+                burstSamples = 0;
+            }
+            length += encodeTemperature(temperatureDeviceSimulator, samples[i], burst + length);
+            burstSamples++;
+        }
+        temperatureDeviceSimulator->samplesSent += count;
+    }
+
+    if (length > 0 && sendBurst(temperatureDeviceSimulator, burst, length, burstSamples) < 0) {
+        return -1;
+    }
+
+    temperatureDeviceSimulator->tickIndex = elapsedNs / temperatureDeviceSimulator->tickNs + 1;
+    return 0;
+}
+
+typedef struct {
+    int year, month, day, hour;
+    time_t hourStart;
+} TraceClock;
+
+// Переводит строку трассы в (секунды, значение). mktime зовётся только при смене часа.
+static bool parseTraceLine(const char *line, TraceClock *clock, long long *timestamp, double *temperature) {
+    int year, month, day, hour, minute, second;
+    if (sscanf(line, "%4d-%2d-%2d %2d:%2d:%2d %lf", &year, &month, &day, &hour, &minute, &second, temperature) == 7) {
+        if (year != clock->year || month != clock->month || day != clock->day || hour != clock->hour) {
+            struct tm tmHour = { .tm_year = year - 1900, .tm_mon = month - 1, .tm_mday = day, .tm_hour = hour, .tm_isdst = -1 };
+            clock->hourStart = mktime(&tmHour);
+            clock->year = year;
+            clock->month = month;
+            clock->day = day;
+            clock->hour = hour;
+        }
+        *timestamp = (long long)clock->hourStart + minute * 60 + second;
+        return true;
+    }
+
+    char separator;
+    return sscanf(line, "%lld%c%lf", timestamp, &separator, temperature) == 3 && (separator == ',' || separator == '|');
+}
+
+typedef struct {
+    TraceClock clock;
+    long long from, to;  // [from, to), 0 - без границы
+    double speed;
+    long long firstTimestamp, batchTimestamp, replayed;
+    long long startNs;
+    char burst[SIMULATOR_BURST_SIZE];
+    size_t length;
+} TraceReplay;
+
+static bool replayTraceFile(TemperatureDeviceSimulator *temperatureDeviceSimulator, const char *path, TraceReplay *replay) {
+    FILE *trace = fopen(path, "r");
+    if (!trace) {
+        perror("Ошибка: файл трассы не открыт.\n");
+        return false;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), trace)) {
+        long long timestamp;
+        double temperature;
+        if (!parseTraceLine(line, &replay->clock, &timestamp, &temperature)) {
+            continue;
+        }
+        if ((replay->from > 0 && timestamp < replay->from) || (replay->to > 0 && timestamp >= replay->to)) {
+            continue;
+        }
+        if (replay->replayed == 0) {
+            replay->firstTimestamp = replay->batchTimestamp = timestamp;
+        }
+
+        // Отсчёты одной секунды уходят одной пачкой; перед следующей секундой сбрасываем пачку и ждём её дедлайна
+        if (timestamp != replay->batchTimestamp || replay->length + TEMPERATURE_BUFFER_SIZE > sizeof(replay->burst)) {
+            if (replay->length > 0 && writeAll(temperatureDeviceSimulator->serialPort, replay->burst, replay->length) < 0) {
+                fclose(trace);
+                return false;
+            }
+            replay->length = 0;
+            replay->batchTimestamp = timestamp;
+            if (replay->speed > 0) {
+                SleepUntilNs(replay->startNs + (long long)((timestamp - replay->firstTimestamp) * 1e9 / replay->speed));
+            }
+        }
+
+        replay->length += encodeTemperature(temperatureDeviceSimulator, temperature, replay->burst + replay->length);
+        replay->replayed++;
+    }
+    fclose(trace);
+    return true;
+}
+
+long long TemperatureDeviceSimulatorReplay(TemperatureDeviceSimulator *temperatureDeviceSimulator, const char *tracePath,
+                                           long long from, long long to, double speed) {
+    TraceReplay *replay = (TraceReplay *)calloc(1, sizeof(TraceReplay));
+    if (!replay) return -1;
+    replay->from = from;
+    replay->to = to;
+    replay->speed = speed;
+    replay->startNs = MonotonicNowNs();
+
+    // У сегментированного лога читаем по манифесту только сегменты, пересекающие диапазон
+    bool success = true;
+    SegmentedLog segmentedLog;
+    if (SegmentedLogLoad(&segmentedLog, tracePath)) {
+        const LogSegment *segments;
+        time_t end = (to > 0) ? (time_t)to : segmentedLog.segments[segmentedLog.segmentCount - 1].end;
+        size_t count = SegmentedLogSelect(&segmentedLog, (time_t)from, end, &segments);
+        for (size_t i = 0; i < count && success; i++) {
+            success = replayTraceFile(temperatureDeviceSimulator, segments[i].path, replay);
+        }
+    } else {
+        success = replayTraceFile(temperatureDeviceSimulator, tracePath, replay);
+    }
+    SegmentedLogClose(&segmentedLog);
+
+    if (success && replay->length > 0 && writeAll(temperatureDeviceSimulator->serialPort, replay->burst, replay->length) < 0) {
+        success = false;
+    }
+
+    long long replayed = replay->replayed;
+    double elapsed = (MonotonicNowNs() - replay->startNs) / 1e9;
+    free(replay);
+    if (!success) return -1;
+
+    printf("Трасса %s проиграна: %lld отсч. за %.1f с\n", tracePath, replayed, elapsed);
+    return replayed;
+}
+
+static void runAtRate(TemperatureDeviceSimulator *temperatureDeviceSimulator) {
+    long long nowNs = MonotonicNowNs();
+    long long lastReportNs = nowNs;
+    TemperatureDeviceSimulatorStart(temperatureDeviceSimulator, nowNs);
+
+    while (1) {
+        SleepUntilNs(TemperatureDeviceSimulatorNextDeadline(temperatureDeviceSimulator));
+
+        nowNs = MonotonicNowNs();
+        if (TemperatureDeviceSimulatorTick(temperatureDeviceSimulator, nowNs) < 0) {
+            printf("Ошибка записи на порт %s\n", temperatureDeviceSimulator->portName);
+            break;
+        }
+
+        if (nowNs - lastReportNs >= SIMULATOR_REPORT_INTERVAL * 1000000000LL) {
+            TemperatureDeviceSimulatorStats stats;
+            TemperatureDeviceSimulatorGetStats(temperatureDeviceSimulator, nowNs, &stats);
+            printf("Симулятор %s: %.1f отсч/с (цель %.1f), задержка пробуждения %.1f±%.1f мкс, макс %.1f мкс\n",
+                   temperatureDeviceSimulator->portName, stats.achievedRate, temperatureDeviceSimulator->samplesPerSecond,
+                   stats.jitterMeanUs, stats.jitterStdDevUs, stats.jitterMaxUs);
+            lastReportNs = nowNs;
+        }
+    }
+}
+#endif
+
+void TemperatureDeviceSimulatorGetStats(
+    const TemperatureDeviceSimulator *temperatureDeviceSimulator, long long nowNs, TemperatureDeviceSimulatorStats *stats
+    ) {
+    double elapsed = (nowNs - temperatureDeviceSimulator->startNs) / 1e9;
+    double wakeups = (double)temperatureDeviceSimulator->wakeups;
+
+    // samplesSent ведёт расписание и включает потерянные на полном порту отсчёты
+    stats->samples = temperatureDeviceSimulator->samplesSent - temperatureDeviceSimulator->samplesDropped;
+    stats->dropped = temperatureDeviceSimulator->samplesDropped;
+    stats->achievedRate = elapsed > 0 ? stats->samples / elapsed : 0.0;
+    stats->jitterMeanUs = wakeups > 0 ? temperatureDeviceSimulator->jitterSumUs / wakeups : 0.0;
+    stats->jitterStdDevUs = wakeups > 0
+        ? sqrt(fmax(temperatureDeviceSimulator->jitterSquaresUs / wakeups - stats->jitterMeanUs * stats->jitterMeanUs, 0.0))
+        : 0.0;
+    stats->jitterMaxUs = temperatureDeviceSimulator->jitterMaxUs;
+}
+
 void TemperatureDeviceSimulatorRun(TemperatureDeviceSimulator *temperatureDeviceSimulator) {
     if (!temperatureDeviceSimulator || !temperatureDeviceSimulator->serialPort) {
         return;
     }
 
+#ifndef _WIN32
+    if (temperatureDeviceSimulator->samplesPerSecond > 0) {
+        runAtRate(temperatureDeviceSimulator);
+        return;
+    }
+#endif
+
     char temperatureBuffer[TEMPERATURE_BUFFER_SIZE];
     
     while (1) {
-        double temperature = smoothedTemperature(
-            temperatureDeviceSimulator->previousTemperature,
-            temperatureDeviceSimulator->minTemperature,
-            temperatureDeviceSimulator->maxTemperature,
-            temperatureDeviceSimulator->alpha
-            );
+        double temperature = nextTemperature(temperatureDeviceSimulator);
 
-        snprintf(temperatureBuffer, TEMPERATURE_BUFFER_SIZE, "%f\n", temperature);
+        size_t length = encodeTemperature(temperatureDeviceSimulator, temperature, temperatureBuffer);
 
-        int bytesWritten = SerialWrite(temperatureDeviceSimulator->serialPort, temperatureBuffer, strlen(temperatureBuffer));
-        if (bytesWritten < 0) {
+        // Логгер может отставать: ждём места в порту, а не теряем кадр или его хвост
+        if (writeAll(temperatureDeviceSimulator->serialPort, temperatureBuffer, length) < 0) {
             printf("Ошибка записи на порт %s\n", temperatureDeviceSimulator->portName);
             break;
         }
 
-        // printf("Отправлено в порт %s: %s", temperatureDeviceSimulator->portName, temperatureBuffer);
+        // printf("Отправлено в порт %s: %f\n", temperatureDeviceSimulator->portName, temperature);
 
         SleepMs(temperatureDeviceSimulator->intervalMs);
     }
@@ -6,6 +6,9 @@
 #include <string.h>
 #include <time.h>
 #include "SerialPort.h"
+#include "SensorFrame.h"
+#include "Random.h"
+#include "SegmentedLog.h"
 
 #ifdef _WIN32
     #include <windows.h>
@@ -17,6 +20,15 @@
 
 #define TEMPERATURE_BUFFER_SIZE 32
 
+#define SIMULATOR_MIN_TICK_NS     1000000LL  // чаще таймер не заводим - пишем пачками
+#define SIMULATOR_BURST_SIZE      4096
+#define SIMULATOR_BATCH_SIZE      128
+#define SIMULATOR_REPORT_INTERVAL 10         // секунд между отчётами о темпе
+
+#if TEMPERATURE_BUFFER_SIZE < SENSOR_FRAME_SIZE
+    #error "TEMPERATURE_BUFFER_SIZE must fit a binary sensor frame"
+#endif
+
 typedef struct {
     SerialPort *serialPort;
     const char *portName;
@@ -26,9 +38,38 @@ typedef struct {
     double previousTemperature;
     double alpha;
     int intervalMs;
+    SensorProtocol protocol;  // по умолчанию текстовый "%f\n"
+    uint16_t sensorId;
+    double samplesPerSecond;  // > 0 - точный темп по абсолютным дедлайнам вместо intervalMs
+    bool dropWhenFull;        // Tick не ждёт полный порт: хвост пачки откладывается, новые отсчёты теряются
+    RandomState random;
+
+    // Состояние планировщика темпа, наносекунды CLOCK_MONOTONIC
+    long long startNs;
+    long long tickNs;
+    unsigned long long tickIndex;
+    unsigned long long samplesSent;     // наступившие по расписанию, включая samplesDropped
+    unsigned long long wakeups;
+    double jitterSumUs;
+    double jitterSquaresUs;
+    double jitterMaxUs;
+
+    // dropWhenFull: не принятый портом хвост пачки дописывается на следующих шагах
+    char pending[SIMULATOR_BURST_SIZE];
+    size_t pendingLength;
+    unsigned long long samplesDropped;
 } TemperatureDeviceSimulator;
 
-double generateRandomTemperature(double minTemperature, double maxTemperature);
+typedef struct {
+    unsigned long long samples;
+    unsigned long long dropped;
+    double achievedRate;
+    double jitterMeanUs;
+    double jitterStdDevUs;
+    double jitterMaxUs;
+} TemperatureDeviceSimulatorStats;
+
+double generateRandomTemperature(RandomState *random, double minTemperature, double maxTemperature);
 
 TemperatureDeviceSimulator* TemperatureDeviceSimulatorInit(
     const char *portName,
@@ -39,8 +80,51 @@ TemperatureDeviceSimulator* TemperatureDeviceSimulatorInit(
     int intervalMs
     );
 
+// То же, но с уже открытым портом (например, концом пары псевдотерминалов); симулятор забирает его себе.
+TemperatureDeviceSimulator* TemperatureDeviceSimulatorInitWithPort(
+    SerialPort *serialPort,
+    double minTemperature,
+    double maxTemperature,
+    double alpha,
+    int intervalMs
+    );
+
+// Задаёт зерно генератора для воспроизводимых прогонов (по умолчанию - от времени и адреса симулятора)
+void TemperatureDeviceSimulatorSeed(TemperatureDeviceSimulator *temperatureDeviceSimulator, uint64_t seed);
+
+// Заполняет samples следующими count сглаженными значениями
+void TemperatureDeviceSimulatorGenerate(TemperatureDeviceSimulator *temperatureDeviceSimulator, double *samples, size_t count);
+
 void TemperatureDeviceSimulatorClose(TemperatureDeviceSimulator *temperatureDeviceSimulator);
 
 void TemperatureDeviceSimulatorRun(TemperatureDeviceSimulator *temperatureDeviceSimulator);
 
+#ifndef _WIN32
+// Планировщик темпа по шагам: Start задаёт отсчёт, Tick пишет все отсчёты, набежавшие к nowNs,
+// NextDeadline - абсолютное время следующего пробуждения.
+void TemperatureDeviceSimulatorStart(TemperatureDeviceSimulator *temperatureDeviceSimulator, long long nowNs);
+
+int TemperatureDeviceSimulatorTick(TemperatureDeviceSimulator *temperatureDeviceSimulator, long long nowNs);
+
+long long TemperatureDeviceSimulatorNextDeadline(const TemperatureDeviceSimulator *temperatureDeviceSimulator);
+
+long long MonotonicNowNs();
+
+// Проигрывает в порт записанную трассу: строки TemperatureLog.txt ("YYYY-MM-DD HH:MM:SS value")
+// или выгрузку БД ("timestamp,temperature" / "timestamp|temperature"), сохраняя интервалы между
+// отсчётами, ускоренные в speed раз. speed <= 0 - без пауз. Проигрываются отсчёты из [from, to)
+// (unix-время, 0 - без границы); если у tracePath есть манифест сегментированного лога, открываются
+// только сегменты, пересекающие диапазон. Возвращает число отсчётов или -1.
+long long TemperatureDeviceSimulatorReplay(TemperatureDeviceSimulator *temperatureDeviceSimulator, const char *tracePath,
+                                           long long from, long long to, double speed);
+
+void SleepUntilNs(long long deadlineNs);
+#endif
+
+void TemperatureDeviceSimulatorGetStats(
+    const TemperatureDeviceSimulator *temperatureDeviceSimulator,
+    long long nowNs,
+    TemperatureDeviceSimulatorStats *stats
+    );
+
 #endif // TEMPERATURE_DEVICE_SIMULATOR_H
\ No newline at end of file
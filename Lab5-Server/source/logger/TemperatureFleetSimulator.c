@@ -0,0 +1,193 @@
+#include "TemperatureFleetSimulator.h"
+
+#define FLEET_IDLE_WAKEUP_NS 100000000LL  // проверка флага остановки не реже раза в 100 мс
+
+#ifndef _WIN32
+static bool deadlineBefore(const TemperatureDeviceSimulator *a, const TemperatureDeviceSimulator *b) {
+    return TemperatureDeviceSimulatorNextDeadline(a) < TemperatureDeviceSimulatorNextDeadline(b);
+}
+
+static void heapSiftDown(TemperatureFleetWorker *worker, size_t index) {
+    TemperatureDeviceSimulator **heap = worker->heap;
+    while (1) {
+        size_t smallest = index;
+        size_t left = 2 * index + 1;
+        size_t right = left + 1;
+        if (left < worker->count && deadlineBefore(heap[left], heap[smallest])) smallest = left;
+        if (right < worker->count && deadlineBefore(heap[right], heap[smallest])) smallest = right;
+        if (smallest == index) return;
+
+        TemperatureDeviceSimulator *swap = heap[index];
+        heap[index] = heap[smallest];
+        heap[smallest] = swap;
+        index = smallest;
+    }
+}
+
+static void *runFleetWorker(void *arg) {
+    TemperatureFleetWorker *worker = (TemperatureFleetWorker *)arg;
+
+    long long nowNs = MonotonicNowNs();
+    for (size_t i = 0; i < worker->count; i++) {
+        TemperatureDeviceSimulatorStart(worker->heap[i], nowNs);
+    }
+
+    while (worker->fleet->running && worker->count > 0) {
+        TemperatureDeviceSimulator *device = worker->heap[0];
+        long long deadlineNs = TemperatureDeviceSimulatorNextDeadline(device);
+
+        nowNs = MonotonicNowNs();
+        if (deadlineNs > nowNs + FLEET_IDLE_WAKEUP_NS) {
+            SleepUntilNs(nowNs + FLEET_IDLE_WAKEUP_NS);
+            continue;
+        }
+        SleepUntilNs(deadlineNs);
+
+        if (TemperatureDeviceSimulatorTick(device, MonotonicNowNs()) < 0) {
+            // Устройство с мёртвым портом выводим из кучи, остальные продолжают работать
+            printf("Ошибка записи на порт %s, устройство %u остановлено\n", device->portName, device->sensorId);
+            worker->heap[0] = worker->heap[--worker->count];
+        }
+        heapSiftDown(worker, 0);
+    }
+
+    return NULL;
+}
+#endif
+
+TemperatureFleetSimulator* TemperatureFleetSimulatorInit(
+    const TemperatureFleetDeviceConfig *devices, size_t deviceCount, size_t workerCount, int baudRate, SensorProtocol protocol
+    ) {
+#ifdef _WIN32
+    (void)devices; (void)deviceCount; (void)workerCount; (void)baudRate; (void)protocol;
+    return NULL;
+#else
+    for (size_t i = 0; i < deviceCount; i++) {
+        if (!(devices[i].samplesPerSecond > 0)) {
+            fprintf(stderr, "Ошибка: устройство %u парка с темпом %f отсч/с\n", devices[i].sensorId, devices[i].samplesPerSecond);
+            return NULL;
+        }
+    }
+
+    if (workerCount == 0) workerCount = 1;
+    if (workerCount > deviceCount) workerCount = deviceCount;
+
+    TemperatureFleetSimulator *fleet = (TemperatureFleetSimulator *)calloc(1, sizeof(TemperatureFleetSimulator));
+    if (!fleet) return NULL;
+
+    fleet->devices = (TemperatureDeviceSimulator **)calloc(deviceCount, sizeof(TemperatureDeviceSimulator *));
+    fleet->workers = (TemperatureFleetWorker *)calloc(workerCount, sizeof(TemperatureFleetWorker));
+    if (!fleet->devices || !fleet->workers) {
+        TemperatureFleetSimulatorClose(fleet);
+        return NULL;
+    }
+    fleet->workerCount = workerCount;
+
+    for (size_t i = 0; i < workerCount; i++) {
+        fleet->workers[i].fleet = fleet;
+        fleet->workers[i].heap = (TemperatureDeviceSimulator **)calloc(deviceCount / workerCount + 1, sizeof(TemperatureDeviceSimulator *));
+        if (!fleet->workers[i].heap) {
+            TemperatureFleetSimulatorClose(fleet);
+            return NULL;
+        }
+    }
+
+    for (size_t i = 0; i < deviceCount; i++) {
+        const TemperatureFleetDeviceConfig *config = &devices[i];
+        SerialPort *serialPort = config->serialPort ? config->serialPort : SerialOpen(config->portName, baudRate);
+        if (!serialPort) {
+            fprintf(stderr, "Ошибка: не удалось открыть порт %s\n", config->portName);
+            TemperatureFleetSimulatorClose(fleet);
+            return NULL;
+        }
+
+        TemperatureDeviceSimulator *device = TemperatureDeviceSimulatorInitWithPort(
+            serialPort, config->minTemperature, config->maxTemperature, config->alpha, 0
+            );
+        if (!device) {
+            SerialClose(serialPort);
+            TemperatureFleetSimulatorClose(fleet);
+            return NULL;
+        }
+        device->sensorId = config->sensorId;
+        device->samplesPerSecond = config->samplesPerSecond;
+        device->dropWhenFull = true;  // полный порт одного устройства не должен задерживать соседей по потоку
+        device->protocol = protocol;
+        if (config->seed != 0) {
+            TemperatureDeviceSimulatorSeed(device, config->seed);
+        }
+        fleet->devices[fleet->deviceCount++] = device;
+
+        // Все устройства стартуют в один момент, поэтому куча изначально упорядочена
+        TemperatureFleetWorker *worker = &fleet->workers[i % workerCount];
+        worker->heap[worker->count++] = device;
+    }
+
+    return fleet;
+#endif
+}
+
+bool TemperatureFleetSimulatorStart(TemperatureFleetSimulator *fleet) {
+#ifdef _WIN32
+    (void)fleet;
+    return false;
+#else
+    if (!fleet) return false;
+
+    fleet->running = true;
+    for (size_t i = 0; i < fleet->workerCount; i++) {
+        if (pthread_create(&fleet->workers[i].thread, NULL, runFleetWorker, &fleet->workers[i]) != 0) {
+            fleet->workerCount = i;
+            TemperatureFleetSimulatorStop(fleet);
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+void TemperatureFleetSimulatorStop(TemperatureFleetSimulator *fleet) {
+    if (!fleet || !fleet->running) return;
+
+    fleet->running = false;
+    for (size_t i = 0; i < fleet->workerCount; i++) {
+        pthread_join(fleet->workers[i].thread, NULL);
+    }
+}
+
+void TemperatureFleetSimulatorClose(TemperatureFleetSimulator *fleet) {
+    if (!fleet) return;
+
+    TemperatureFleetSimulatorStop(fleet);
+    for (size_t i = 0; i < fleet->deviceCount; i++) {
+        TemperatureDeviceSimulatorClose(fleet->devices[i]);
+    }
+    if (fleet->workers) {
+        for (size_t i = 0; i < fleet->workerCount; i++) {
+            free(fleet->workers[i].heap);
+        }
+    }
+    free(fleet->workers);
+    free(fleet->devices);
+    free(fleet);
+}
+
+void TemperatureFleetSimulatorGetStats(TemperatureFleetSimulator *fleet, TemperatureDeviceSimulatorStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!fleet) return;
+
+#ifndef _WIN32
+    long long nowNs = MonotonicNowNs();
+    for (size_t i = 0; i < fleet->deviceCount; i++) {
+        TemperatureDeviceSimulatorStats device;
+        TemperatureDeviceSimulatorGetStats(fleet->devices[i], nowNs, &device);
+
+        stats->samples += device.samples;
+        stats->dropped += device.dropped;
+        stats->achievedRate += device.achievedRate;
+        stats->jitterMeanUs += device.jitterMeanUs / fleet->deviceCount;
+        if (device.jitterStdDevUs > stats->jitterStdDevUs) stats->jitterStdDevUs = device.jitterStdDevUs;
+        if (device.jitterMaxUs > stats->jitterMaxUs) stats->jitterMaxUs = device.jitterMaxUs;
+    }
+#endif
+}
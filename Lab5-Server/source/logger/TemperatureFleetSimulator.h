@@ -0,0 +1,57 @@
+#ifndef TEMPERATURE_FLEET_SIMULATOR_H
+#define TEMPERATURE_FLEET_SIMULATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "TemperatureDeviceSimulator.h"
+
+// Парк виртуальных датчиков: сотни устройств со своими портами, id, темпом и сглаживанием
+// обслуживаются небольшим пулом потоков, каждый из которых ведёт кучу дедлайнов своих устройств.
+typedef struct {
+    SerialPort *serialPort;  // уже открытый порт или канал; иначе открывается portName
+    const char *portName;
+    uint16_t sensorId;
+    double samplesPerSecond;
+    double alpha;
+    double minTemperature;
+    double maxTemperature;
+    uint64_t seed;  // 0 - зерно по умолчанию
+} TemperatureFleetDeviceConfig;
+
+typedef struct TemperatureFleetSimulator TemperatureFleetSimulator;
+
+typedef struct {
+    TemperatureFleetSimulator *fleet;
+    pthread_t thread;
+    TemperatureDeviceSimulator **heap;  // min-куча по следующему дедлайну
+    size_t count;
+} TemperatureFleetWorker;
+
+struct TemperatureFleetSimulator {
+    TemperatureDeviceSimulator **devices;
+    size_t deviceCount;
+    TemperatureFleetWorker *workers;
+    size_t workerCount;
+    volatile bool running;
+};
+
+TemperatureFleetSimulator* TemperatureFleetSimulatorInit(
+    const TemperatureFleetDeviceConfig *devices,
+    size_t deviceCount,
+    size_t workerCount,
+    int baudRate,
+    SensorProtocol protocol
+    );
+
+bool TemperatureFleetSimulatorStart(TemperatureFleetSimulator *fleet);
+
+void TemperatureFleetSimulatorStop(TemperatureFleetSimulator *fleet);
+
+void TemperatureFleetSimulatorClose(TemperatureFleetSimulator *fleet);
+
+// Суммарный темп и худшая задержка пробуждения по всему парку
+void TemperatureFleetSimulatorGetStats(TemperatureFleetSimulator *fleet, TemperatureDeviceSimulatorStats *stats);
+
+#endif // TEMPERATURE_FLEET_SIMULATOR_H
@@ -1,173 +1,429 @@
 #include "TemperatureLogger.h"
 
-void WriteToFile(const char *filePath, const char *data) {
-    FILE *file = fopen(filePath, "a+");
-    if (file) {
-        fprintf(file, "%s\n", data);
-        fclose(file);
-    } else {
-        perror("Ошибка: файл не открыт.\n");
-    }
-}
+// Пачка отсчётов уходит в БД одной транзакцией; пачка принадлежит потоку стока БД
+void WriteToDatabase(TemperatureLogger *logger) {
+    if (logger->dbBatchCount == 0) return;
 
-void WriteToDatabase(double temperature) {
-    bool result = database_insert_temperature(temperature);
-
-    if (!result) {
+    if (!database_insert_temperatures(logger->dbBatch, (int)logger->dbBatchCount)) {
         perror("Ошибка записи температуры в базу данных.\n");
     }
+    logger->dbBatchCount = 0;
+    logger->dbCommits++;
 }
 
-void CleanupLogFile(const char *filePath, int maxHours) {
-    FILE *file = fopen(filePath, "r");
-    if (!file) return;
-
-    char lines[1024][256];
-    int count = 0;
-    time_t now = time(NULL);
-    struct tm entryTime;
-
-    while (fgets(lines[count], sizeof(lines[count]), file)) {
-        sscanf(lines[count], "%4d-%2d-%2d %2d:", &entryTime.tm_year, &entryTime.tm_mon, &entryTime.tm_mday, &entryTime.tm_hour);
-        entryTime.tm_year -= 1900;
-        entryTime.tm_mon -= 1;
-        entryTime.tm_min = entryTime.tm_sec = 0;
-
-        if (difftime(now, mktime(&entryTime)) <= maxHours * 3600) {
-            count++;
-        }
-    }
-    fclose(file);
-
-    file = fopen(filePath, "w");
-    if (file) {
-        for (int i = 0; i < count; i++) {
-            fprintf(file, "%s", lines[i]);
-        }
-        fclose(file);
-    }
+// Проходы очистки идут в потоке-владельце лога, поэтому не пересекаются с записью
+static void retainLog(SegmentedLog *log, int retentionHours) {
+    SegmentedLogRetain(log, time(NULL) - (time_t)retentionHours * 3600);
 }
 
+static void emitRollup(void *context, const RollupBucket *bucket);
+
 TemperatureLogger* TemperatureLoggerInit(
-    const char *portName, int baudRate, const char *logFilePath, const char *hourlyLogFilePath, const char *dailyLogFilePath
+    const TemperatureLoggerPortConfig *ports, size_t portCount, int baudRate,
+    const char *logFilePath, const char *hourlyLogFilePath, const char *dailyLogFilePath, const LogFlushPolicy *flushPolicy
     ) {
-    TemperatureLogger *logger = (TemperatureLogger *)malloc(sizeof(TemperatureLogger));
+    TemperatureLogger *logger = (TemperatureLogger *)calloc(1, sizeof(TemperatureLogger));
     if (!logger) return NULL;
 
-    logger->portName = portName;
     logger->baudRate = baudRate;
-    strncpy(logger->logFilePath, logFilePath, sizeof(logger->logFilePath) - 1);
-    strncpy(logger->hourlyLogFilePath, hourlyLogFilePath, sizeof(logger->hourlyLogFilePath) - 1);
-    strncpy(logger->dailyLogFilePath, dailyLogFilePath, sizeof(logger->dailyLogFilePath) - 1);
-    logger->logFilePath[sizeof(logger->logFilePath) - 1] = '\0';
-    logger->hourlyLogFilePath[sizeof(logger->hourlyLogFilePath) - 1] = '\0';
-    logger->dailyLogFilePath[sizeof(logger->dailyLogFilePath) - 1] = '\0';
-
-    FILE *log = fopen(logger->logFilePath, "w");
-    FILE *hourlyLog = fopen(logger->hourlyLogFilePath, "w");
-    FILE *dailyLog = fopen(logger->dailyLogFilePath, "w");
-
-    if (!log || !hourlyLog || !dailyLog) {
+    logger->protocol = SENSOR_PROTOCOL_TEXT;
+    logger->running = true;
+    logger->queueCapacity = LOGGER_QUEUE_CAPACITY;
+    logger->queuePolicy = SAMPLE_QUEUE_DROP_NEWEST;
+    logger->dbBatchSize = LOGGER_DB_BATCH_SIZE;
+    logger->dbCommitIntervalMs = LOGGER_DB_COMMIT_MS;
+    RollupEngineInit(&logger->rollups, emitRollup, logger);
+    TimestampFormatterInit(&logger->textClock);
+    TimestampFormatterInit(&logger->rollupClock);
+
+    bool logOpened = SegmentedLogOpen(&logger->log, logFilePath, LOG_SEGMENT_HOURLY, flushPolicy);
+    bool hourlyLogOpened = SegmentedLogOpen(&logger->hourlyLog, hourlyLogFilePath, LOG_SEGMENT_DAILY, flushPolicy);
+    bool dailyLogOpened = SegmentedLogOpen(&logger->dailyLog, dailyLogFilePath, LOG_SEGMENT_MONTHLY, flushPolicy);
+
+    if (!logOpened || !hourlyLogOpened || !dailyLogOpened) {
       perror("Ошибка: файлы логов не созданы.\n");
     }
 
-    logger->serialPort = SerialOpen(portName, baudRate);
-    if (!logger->serialPort) {
-        free(logger);
+    logger->ports = (TemperatureLoggerPort *)calloc(portCount, sizeof(TemperatureLoggerPort));
+    logger->poller = SerialPollerInit(portCount);
+    if (!logger->ports || !logger->poller) {
+        TemperatureLoggerClose(logger);
         return NULL;
     }
 
+    for (size_t i = 0; i < portCount; i++) {
+        TemperatureLoggerPort *port = &logger->ports[i];
+        SerialFramerInit(&port->framer);
+        port->sensorId = ports[i].sensorId;
+
+        port->serialPort = ports[i].serialPort ? ports[i].serialPort : SerialOpen(ports[i].portName, baudRate);
+        logger->portCount++;
+        if (!port->serialPort || !SerialPollerAdd(logger->poller, port->serialPort, port)) {
+            fprintf(stderr, "Ошибка: не удалось открыть порт %s\n",
+                    ports[i].serialPort ? ports[i].serialPort->portName : ports[i].portName);
+            TemperatureLoggerClose(logger);
+            return NULL;
+        }
+        port->active = true;
+    }
+
     return logger;
 }
 
 void TemperatureLoggerClose(TemperatureLogger *logger) {
     if (logger) {
-        SerialClose(logger->serialPort);
+        SerialPollerClose(logger->poller);
+        for (size_t i = 0; i < logger->portCount; i++) {
+            if (logger->ports[i].serialPort) {
+                SerialClose(logger->ports[i].serialPort);
+            }
+        }
+        free(logger->ports);
+        free(logger->dbBatch);
+        for (size_t i = 0; i < LOGGER_SINK_COUNT; i++) {
+            TemperatureSinkDestroy(&logger->sinks[i]);
+        }
+        SegmentedLogClose(&logger->log);
+        SegmentedLogClose(&logger->hourlyLog);
+        SegmentedLogClose(&logger->dailyLog);
+        CompressedLogClose(&logger->compressedLog);
+        RollupEngineClose(&logger->rollups);
         free(logger);
     }
 }
 
-void LogTemperature(TemperatureLogger *logger, double temperature) {
-    time_t now = time(NULL);
-    struct tm *tmNow = localtime(&now);
+bool TemperatureLoggerRestoreCheckpoint(TemperatureLogger *logger, const char *path) {
+    strncpy(logger->checkpointPath, path, sizeof(logger->checkpointPath) - 1);
+    logger->lastCheckpoint = time(NULL);
+
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return true;  // первый запуск - восстанавливать нечего
+    }
+    fclose(file);
+
+    if (!RollupEngineLoad(&logger->rollups, path)) {
+        fprintf(stderr, "Ошибка: контрольная точка %s повреждена, агрегаты начаты заново\n", path);
+        return false;
+    }
+    return true;
+}
 
+static void saveCheckpoint(TemperatureLogger *logger) {
+    if (logger->checkpointPath[0] == '\0') return;
+
+    // Отданные корзины сначала должны лечь на диск в логах: иначе после сбоя их не будет
+    // ни в логе, ни в контрольной точке. Не вышло - попробуем при следующем сохранении
+    if (logger->rollups.emitted != logger->checkpointEmitted) {
+        bool hourlySynced = SegmentedLogSync(&logger->hourlyLog);
+        bool dailySynced = SegmentedLogSync(&logger->dailyLog);
+        if (!hourlySynced || !dailySynced) return;
+    }
+
+    if (!RollupEngineSave(&logger->rollups, logger->checkpointPath)) {
+        perror("Ошибка сохранения контрольной точки агрегатов.\n");
+    }
+    logger->lastCheckpoint = time(NULL);
+    logger->checkpointEmitted = logger->rollups.emitted;
+}
+
+bool TemperatureLoggerUseCompressedLog(TemperatureLogger *logger, const char *path) {
+    if (!CompressedLogOpen(&logger->compressedLog, path)) {
+        fprintf(stderr, "Ошибка: не удалось открыть сжатый лог %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+static int64_t wallClockMs() {
+#ifdef _WIN32
+    FILETIME fileTime;
+    GetSystemTimeAsFileTime(&fileTime);
+    ULARGE_INTEGER ticks = { .LowPart = fileTime.dwLowDateTime, .HighPart = fileTime.dwHighDateTime };
+    return (int64_t)(ticks.QuadPart / 10000ULL) - 11644473600000LL;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+#endif
+}
+
+void LogTemperature(TemperatureLogger *logger, const TemperatureSample *sample) {
+    time_t timestamp = (time_t)(sample->timestampMs / 1000);
+
+    // Метка времени из кэша форматтера, snprintf - только для значения
     char logEntry[64];
-    snprintf(logEntry, sizeof(logEntry), "%4d-%02d-%02d %02d:%02d:%02d %f",
-             tmNow->tm_year + 1900, tmNow->tm_mon + 1, tmNow->tm_mday,
-             tmNow->tm_hour, tmNow->tm_min, tmNow->tm_sec, temperature);
-    
-    WriteToFile(logger->logFilePath, logEntry);
-    WriteToDatabase((double)temperature);
+    TimestampFormat(&logger->textClock, timestamp, logEntry);
+    snprintf(logEntry + TIMESTAMP_TEXT_SIZE - 1, sizeof(logEntry) - TIMESTAMP_TEXT_SIZE + 1,
+             " %f %u", sample->temperature, sample->sensorId);
+
+    SegmentedLogWriteLine(&logger->log, timestamp, logEntry);
 }
 
-void UpdateHourlyAverage(TemperatureLogger *logger, double* hourlySum, int *hourlyCount, time_t *lastHour) {
-    if (*hourlyCount > 0) {
-        time_t now = time(NULL);
-        struct tm *tmNow = localtime(&now);
+// Законченная корзина: часовые и суточные - в свои логи. Таблицу агрегатов БД ведёт сама БД при вставке
+static void emitRollup(void *context, const RollupBucket *bucket) {
+    TemperatureLogger *logger = (TemperatureLogger *)context;
+    const RollupAccumulator *stats = &bucket->stats;
+    struct tm tmStart;
+    TimestampToLocal(&logger->rollupClock, bucket->start, &tmStart);
 
-        char hourlyEntry[64];
-        snprintf(hourlyEntry, sizeof(hourlyEntry), "%4d-%02d-%02d %02d:00 %f",
-                 tmNow->tm_year + 1900, tmNow->tm_mon + 1, tmNow->tm_mday,
-                 tmNow->tm_hour, *hourlySum / *hourlyCount);
-        WriteToFile(logger->hourlyLogFilePath, hourlyEntry);
+    char rollupEntry[128];
+    if (bucket->resolution == ROLLUP_HOUR) {
+        snprintf(rollupEntry, sizeof(rollupEntry), "%4d-%02d-%02d %02d:00 %f %llu %f %f %f %u",
+                 tmStart.tm_year + 1900, tmStart.tm_mon + 1, tmStart.tm_mday, tmStart.tm_hour,
+                 stats->mean, stats->count, stats->min, stats->max, RollupAccumulatorStdDev(stats), bucket->sensorId);
+        SegmentedLogWriteLine(&logger->hourlyLog, bucket->start, rollupEntry);
+    } else if (bucket->resolution == ROLLUP_DAY) {
+        snprintf(rollupEntry, sizeof(rollupEntry), "%4d-%02d-%02d %f %llu %f %f %f %u",
+                 tmStart.tm_year + 1900, tmStart.tm_mon + 1, tmStart.tm_mday,
+                 stats->mean, stats->count, stats->min, stats->max, RollupAccumulatorStdDev(stats), bucket->sensorId);
+        SegmentedLogWriteLine(&logger->dailyLog, bucket->start, rollupEntry);
     }
-    
-    *hourlySum = 0;
-    *hourlyCount = 0;
-    *lastHour = time(NULL);
 }
 
-void UpdateDailyAverage(TemperatureLogger *logger, double* dailySum, int* dailyCount, time_t* lastDay) {
-    if (*dailyCount > 0) {
-        time_t now = time(NULL);
-        struct tm *tmNow = localtime(&now);
+bool ParseTemperatureLine(const char *line, size_t length, double *temperature) {
+    // Строка в буфере кадров заканчивается '\n', поэтому strtod не выйдет за её пределы
+    char *end;
+    *temperature = strtod(line, &end);
+    if (end == line) {
+        return false;
+    }
+    while (end < line + length && (*end == ' ' || *end == '\t')) {
+        end++;
+    }
+    return end == line + length;
+}
+
+void UpdateAverages(TemperatureLogger *logger) {
+    // Корзины закрываются по часам, даже если отсчёты перестали приходить
+    RollupEngineAdvance(&logger->rollups, time(NULL));
 
-        char dailyEntry[64];
-        snprintf(dailyEntry, sizeof(dailyEntry), "%4d-%02d-%02d %f",
-                 tmNow->tm_year + 1900, tmNow->tm_mon + 1, tmNow->tm_mday,
-                 *dailySum / *dailyCount);
-        WriteToFile(logger->dailyLogFilePath, dailyEntry);
+    SegmentedLogTick(&logger->hourlyLog);
+    SegmentedLogTick(&logger->dailyLog);
+}
+
+static void consumeTextLog(void *context, const TemperatureSample *samples, size_t count) {
+    TemperatureLogger *logger = (TemperatureLogger *)context;
+    for (size_t i = 0; i < count; i++) {
+        if (logger->compressedLog.file) {
+            CompressedLogAppend(&logger->compressedLog, samples[i].sensorId, samples[i].timestampMs, samples[i].temperature);
+        } else {
+            LogTemperature(logger, &samples[i]);
+        }
     }
-    
-    *dailySum = 0;
-    *dailyCount = 0;
-    *lastDay = time(NULL);
 }
 
-void ProcessTemperatureData(TemperatureLogger *logger, double temperature, double* hourlySum, int* hourlyCount, 
-                                   double* dailySum, int* dailyCount, time_t* lastHour, time_t* lastDay) {
+static void idleTextLog(void *context) {
+    TemperatureLogger *logger = (TemperatureLogger *)context;
+    SegmentedLogTick(&logger->log);
+    CompressedLogTick(&logger->compressedLog);
+
     time_t now = time(NULL);
-    
-    *hourlySum += temperature;
-    (*hourlyCount)++;
-    *dailySum += temperature;
-    (*dailyCount)++;
+    if (logger->retentionHours > 0 && difftime(now, logger->lastTextRetention) >= LOGGER_RETENTION_CHECK) {
+        retainLog(&logger->log, logger->retentionHours);
+        logger->lastTextRetention = now;
+    }
+}
+
+static void consumeAverages(void *context, const TemperatureSample *samples, size_t count) {
+    TemperatureLogger *logger = (TemperatureLogger *)context;
+    for (size_t i = 0; i < count; i++) {
+        RollupEngineAdd(&logger->rollups, samples[i].sensorId, (time_t)(samples[i].timestampMs / 1000), samples[i].temperature);
+    }
+}
 
-    LogTemperature(logger, temperature);
+static void idleAverages(void *context) {
+    TemperatureLogger *logger = (TemperatureLogger *)context;
+    UpdateAverages(logger);
 
-    if (difftime(now, *lastHour) >= 3600) {
-        UpdateHourlyAverage(logger, hourlySum, hourlyCount, lastHour);
+    // Сразу после отдачи корзин - чтобы после сбоя они не попали в логи повторно
+    time_t now = time(NULL);
+    if (logger->rollups.emitted != logger->checkpointEmitted ||
+        difftime(now, logger->lastCheckpoint) >= LOGGER_CHECKPOINT_INTERVAL) {
+        saveCheckpoint(logger);
+    }
+
+    if (logger->retentionHours > 0 && difftime(now, logger->lastAveragesRetention) >= LOGGER_RETENTION_CHECK) {
+        retainLog(&logger->hourlyLog, logger->retentionHours);
+        retainLog(&logger->dailyLog, logger->retentionHours);
+        logger->lastAveragesRetention = now;
+    }
+}
+
+static void consumeDatabase(void *context, const TemperatureSample *samples, size_t count) {
+    TemperatureLogger *logger = (TemperatureLogger *)context;
+    for (size_t i = 0; i < count; i++) {
+        if (logger->dbBatchCount == 0) {
+            logger->dbBatchStartedMs = wallClockMs();
+        }
+
+        TemperatureRecord *record = &logger->dbBatch[logger->dbBatchCount++];
+        record->timestamp = (int)(samples[i].timestampMs / 1000);
+        record->temperature = samples[i].temperature;
+        record->sensor = samples[i].sensorId;
+
+        if (logger->dbBatchCount == logger->dbBatchSize) {
+            WriteToDatabase(logger);
+        }
+    }
+}
+
+static void idleDatabase(void *context) {
+    TemperatureLogger *logger = (TemperatureLogger *)context;
+    if (logger->dbBatchCount > 0 && wallClockMs() - logger->dbBatchStartedMs >= logger->dbCommitIntervalMs) {
+        WriteToDatabase(logger);
+    }
+
+    // Раздел удаляется целиком, только когда все его строки старше срока хранения
+    time_t now = time(NULL);
+    if (logger->databaseRetentionHours > 0 && difftime(now, logger->lastDatabaseRetention) >= LOGGER_RETENTION_CHECK) {
+        database_drop_partitions_before((long long)now - (long long)logger->databaseRetentionHours * 3600);
+        logger->lastDatabaseRetention = now;
+    }
+}
+
+void ProcessTemperatureData(TemperatureLogger *logger, const TemperatureSample *sample) {
+    for (size_t i = 0; i < LOGGER_SINK_COUNT; i++) {
+        TemperatureSinkPush(&logger->sinks[i], sample);
+    }
+}
+
+void ProcessSerialFrames(TemperatureLogger *logger, TemperatureLoggerPort *port, int64_t timestampMs) {
+    TemperatureSample sample = { .timestampMs = timestampMs, .sensorId = port->sensorId };
+
+    // Счётчик устройства переполняется каждые 65.5 с и не задаёт дату, поэтому отсчёт
+    // получает время приёма. Кадр чужого датчика на порту считается испорченным,
+    // чтобы не записать его под идентификатором порта
+    if (logger->protocol == SENSOR_PROTOCOL_BINARY) {
+        SensorFrame frame;
+        while (SerialFramerNextFrame(&port->framer, &frame)) {
+            if (frame.sensorId != port->sensorId) {
+                port->framer.malformedFrames++;
+                continue;
+            }
+            port->samples++;
+            sample.temperature = frame.temperature;
+            ProcessTemperatureData(logger, &sample);
+        }
+        return;
+    }
+
+    const char *line;
+    size_t length;
+    while (SerialFramerNextLine(&port->framer, &line, &length)) {
+        if (!ParseTemperatureLine(line, length, &sample.temperature)) {
+            port->framer.malformedFrames++;
+            continue;
+        }
+        // printf("Считана температура из порта %s: %f\n", port->serialPort->portName, sample.temperature);
+        port->samples++;
+        ProcessTemperatureData(logger, &sample);
+    }
+}
+
+void ReadLoggerPort(TemperatureLogger *logger, TemperatureLoggerPort *port) {
+    // Вычитываем всё накопленное, чтобы не просыпаться повторно на тех же данных
+    while (1) {
+        int bytesRead = SerialFramerFill(&port->framer, port->serialPort);
+        if (bytesRead > 0) {
+            ProcessSerialFrames(logger, port, wallClockMs());
+            continue;
+        }
+
+        if (bytesRead == 0 || errno != EAGAIN) {
+            // Устройство отключилось: убираем порт из опроса, чтобы не крутиться на HUP
+            fprintf(stderr, "Ошибка чтения порта %s, порт отключён\n", port->serialPort->portName);
+            port->readErrors++;
+            port->active = false;
+            SerialPollerRemove(logger->poller, port->serialPort);
+        }
+        return;
+    }
+}
+
+static bool startSinks(TemperatureLogger *logger) {
+    static const char *names[LOGGER_SINK_COUNT] = { "text", "averages", "database" };
+    static const TemperatureSinkConsume consume[LOGGER_SINK_COUNT] = { consumeTextLog, consumeAverages, consumeDatabase };
+    static const TemperatureSinkIdle idle[LOGGER_SINK_COUNT] = { idleTextLog, idleAverages, idleDatabase };
+
+    if (logger->dbBatchSize == 0) logger->dbBatchSize = 1;
+    logger->dbBatch = (TemperatureRecord *)malloc(logger->dbBatchSize * sizeof(TemperatureRecord));
+    if (!logger->dbBatch) {
+        return false;
+    }
+
+    for (size_t i = 0; i < LOGGER_SINK_COUNT; i++) {
+        if (!TemperatureSinkStart(&logger->sinks[i], names[i], logger->queueCapacity, logger->queuePolicy,
+                                  consume[i], idle[i], logger)) {
+            fprintf(stderr, "Ошибка: не удалось запустить сток %s\n", names[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void stopSinks(TemperatureLogger *logger) {
+    for (size_t i = 0; i < LOGGER_SINK_COUNT; i++) {
+        TemperatureSinkStop(&logger->sinks[i]);
+    }
+}
+
+void TemperatureLoggerPrintStats(TemperatureLogger *logger) {
+    for (size_t i = 0; i < logger->portCount; i++) {
+        TemperatureLoggerPort *port = &logger->ports[i];
+        printf("Порт %s (датчик %u): отсчётов %lu, битых кадров %lu, отброшено кадров %lu\n",
+               port->serialPort->portName, port->sensorId, port->samples,
+               port->framer.malformedFrames, port->framer.droppedFrames);
     }
+    for (size_t i = 0; i < LOGGER_SINK_COUNT; i++) {
+        SampleQueueStats stats;
+        TemperatureLoggerGetSinkStats(logger, i, &stats);
+        printf("Сток %s: в очереди %zu/%zu (макс. %zu), принято %llu, отброшено %llu\n",
+               logger->sinks[i].name ? logger->sinks[i].name : "-", stats.depth, stats.capacity,
+               stats.highWatermark, stats.pushed, stats.dropped);
+    }
+    printf("БД: транзакций %llu\n", logger->dbCommits);
+}
 
-    if (difftime(now, *lastDay) >= 86400) {
-        UpdateDailyAverage(logger, dailySum, dailyCount, lastDay);
+void TemperatureLoggerGetSinkStats(TemperatureLogger *logger, size_t sink, SampleQueueStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (sink < LOGGER_SINK_COUNT && (logger->sinks[sink].started || logger->sinks[sink].stopped)) {
+        SampleQueueGetStats(&logger->sinks[sink].queue, stats);
     }
 }
 
 void TemperatureLoggerRun(TemperatureLogger *logger) {
-    time_t lastHour = time(NULL);
-    time_t lastDay = time(NULL);
-    int hourlyCount = 0, dailyCount = 0;
-    double hourlySum = 0, dailySum = 0;
+    void *readyPorts[SERIAL_POLLER_MAX_EVENTS];
+
+    if (!startSinks(logger)) {
+        stopSinks(logger);
+        return;
+    }
     
-    while (1) {
-      char buffer[32];
-      if (SerialRead(logger->serialPort, buffer, sizeof(buffer) - 1)) {
-        char *end;
-        double temperature = strtod(buffer, &end);
-        // printf("Считана температура из порта: %f\n", temperature);
-        ProcessTemperatureData(logger, temperature, &hourlySum, &hourlyCount, &dailySum, &dailyCount, &lastHour, &lastDay);
-      }
-      SleepMs(1000);
+    while (logger->running) {
+        // Спим, пока хотя бы в один порт не придут данные; запись на диск и в БД идёт в потоках стоков
+        int ready = SerialPollerWait(logger->poller, readyPorts, SERIAL_POLLER_MAX_EVENTS, LOGGER_HOUSEKEEPING_MS);
+        if (ready < 0) {
+            perror("Ошибка ожидания данных портов.\n");
+            SleepMs(LOGGER_HOUSEKEEPING_MS);
+        }
+
+        for (int i = 0; i < ready; i++) {
+            TemperatureLoggerPort *port = (TemperatureLoggerPort *)readyPorts[i];
+            if (port->active) {
+                ReadLoggerPort(logger, port);
+            }
+        }
+    }
+
+    stopSinks(logger);
+    WriteToDatabase(logger);  // остаток пачки; поток стока БД уже остановлен
+    saveCheckpoint(logger);  // поток стока средних уже остановлен
+    TemperatureLoggerPrintStats(logger);
+}
+
+void TemperatureLoggerStop(TemperatureLogger *logger) {
+    if (logger) {
+        logger->running = false;
     }
 }
\ No newline at end of file
@@ -5,8 +5,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <errno.h>
 
 #include "SerialPort.h"
+#include "SerialFramer.h"
+#include "SerialPoller.h"
+#include "LogFile.h"
+#include "SegmentedLog.h"
+#include "Rollup.h"
+#include "CompressedLog.h"
+#include "TimestampFormatter.h"
+#include "TemperatureSink.h"
 #include "../database/Database.h"
 
 #ifdef _WIN32
@@ -17,25 +26,98 @@
     #define SleepMs(ms) usleep((ms) * 1000)
 #endif
 
+#define LOGGER_HOUSEKEEPING_MS 1000
+#define LOGGER_QUEUE_CAPACITY  65536
+#define LOGGER_RETENTION_CHECK 3600  // секунд между проходами очистки логов
+#define LOGGER_CHECKPOINT_INTERVAL 10  // секунд между контрольными точками агрегатов
+#define LOGGER_DB_BATCH_SIZE   4096  // отсчётов в одной транзакции БД
+#define LOGGER_DB_COMMIT_MS    250   // или не дольше стольких мс от первого отсчёта пачки
+
+// Стоки, которые разбирают отсчёты в своих потоках
+#define LOGGER_SINK_TEXT       0
+#define LOGGER_SINK_AVERAGES   1
+#define LOGGER_SINK_DATABASE   2
+#define LOGGER_SINK_COUNT      3
+
 typedef struct {
-    SerialPort *serialPort;
     const char *portName;
+    uint16_t sensorId;
+    SerialPort *serialPort;  // уже открытый порт вместо portName; логгер забирает его себе
+} TemperatureLoggerPortConfig;
+
+typedef struct {
+    SerialPort *serialPort;
+    SerialFramer framer;
+    uint16_t sensorId;
+    bool active;
+    unsigned long samples;
+    unsigned long readErrors;
+} TemperatureLoggerPort;
+
+typedef struct {
+    TemperatureLoggerPort *ports;
+    size_t portCount;
+    SerialPoller *poller;
+    SensorProtocol protocol;  // должен совпадать с протоколом устройств
     int baudRate;
-    char logFilePath[256];
-    char hourlyLogFilePath[256];
-    char dailyLogFilePath[256];
+    volatile bool running;
+    SegmentedLog log;        // сегменты по часам
+    SegmentedLog hourlyLog;  // по дням
+    SegmentedLog dailyLog;   // по месяцам
+    TimestampFormatter textClock;    // у каждого потока стока свой
+    TimestampFormatter rollupClock;
+    CompressedLog compressedLog;  // открыт - отсчёты пишутся в него вместо текстового лога
+
+    TemperatureSink sinks[LOGGER_SINK_COUNT];
+    size_t queueCapacity;           // задаётся до TemperatureLoggerRun
+    SampleQueuePolicy queuePolicy;  // что делать, когда сток не успевает
+    int retentionHours;             // > 0 - сколько часов хранить записи в логах
+    time_t lastTextRetention;
+    time_t lastAveragesRetention;
+    int databaseRetentionHours;     // > 0 - месячные разделы БД старше стольких часов удаляются целиком
+    time_t lastDatabaseRetention;
+
+    // Агрегаты по часам и суткам, принадлежат потоку стока средних
+    RollupEngine rollups;
+    // Групповая запись в БД, принадлежит потоку стока БД; размеры задаются до TemperatureLoggerRun
+    TemperatureRecord *dbBatch;
+    size_t dbBatchCount;
+    size_t dbBatchSize;
+    int dbCommitIntervalMs;
+    int64_t dbBatchStartedMs;
+    unsigned long long dbCommits;
+
+    char checkpointPath[256];  // пусто - без контрольных точек
+    time_t lastCheckpoint;
+    unsigned long long checkpointEmitted;
 } TemperatureLogger;
 
 TemperatureLogger* TemperatureLoggerInit(
-    const char *portName,
+    const TemperatureLoggerPortConfig *ports,
+    size_t portCount,
     int baudRate,
-    const char *logFilePath,
+    const char *logFilePath,        // базовые имена сегментов и манифеста
     const char *hourlyLogFilePath,
-    const char *dailyLogFilePath
+    const char *dailyLogFilePath,
+    const LogFlushPolicy *flushPolicy  // NULL - LogFlushPolicyDefault()
     );
 
 void TemperatureLoggerClose(TemperatureLogger *logger);
 
+// Восстанавливает незаконченные агрегаты из контрольной точки path (если она есть) и дальше
+// периодически сохраняет их туда же; вызывать до TemperatureLoggerRun
+bool TemperatureLoggerRestoreCheckpoint(TemperatureLogger *logger, const char *path);
+
+// Переключает запись отсчётов на сжатый двоичный лог; вызывать до TemperatureLoggerRun
+bool TemperatureLoggerUseCompressedLog(TemperatureLogger *logger, const char *path);
+
 void TemperatureLoggerRun(TemperatureLogger *logger);
 
+void TemperatureLoggerGetSinkStats(TemperatureLogger *logger, size_t sink, SampleQueueStats *stats);
+
+void TemperatureLoggerPrintStats(TemperatureLogger *logger);
+
+// Просит цикл TemperatureLoggerRun завершиться; буферы логов сбрасываются в TemperatureLoggerClose
+void TemperatureLoggerStop(TemperatureLogger *logger);
+
 #endif // TEMPERATURE_LOGGER_H
\ No newline at end of file
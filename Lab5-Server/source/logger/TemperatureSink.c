@@ -0,0 +1,117 @@
+#include <time.h>
+#include <errno.h>
+
+#include "TemperatureSink.h"
+
+static void waitForSamples(TemperatureSink *sink) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += TEMPERATURE_SINK_IDLE_MS * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    // sleeping выставляется до повторной проверки очереди: писатель либо увидит флаг,
+    // либо мы увидим его отсчёт, поэтому сигнал не теряется. Для этого пары "запись -
+    // чтение" на обеих сторонах разделены полным барьером (парный - в TemperatureSinkPush)
+    pthread_mutex_lock(&sink->mutex);
+    atomic_store(&sink->sleeping, true);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (SampleQueueEmpty(&sink->queue) && atomic_load(&sink->running)) {
+        pthread_cond_timedwait(&sink->wakeup, &sink->mutex, &deadline);
+    }
+    atomic_store(&sink->sleeping, false);
+    pthread_mutex_unlock(&sink->mutex);
+}
+
+static void *runSink(void *arg) {
+    TemperatureSink *sink = (TemperatureSink *)arg;
+    TemperatureSample batch[TEMPERATURE_SINK_BATCH_SIZE];
+
+    while (1) {
+        size_t count = SampleQueuePopBatch(&sink->queue, batch, TEMPERATURE_SINK_BATCH_SIZE);
+        if (count > 0) {
+            sink->consume(sink->context, batch, count);
+        }
+
+        // idle зовётся и под нагрузкой, иначе сброс по времени не наступит никогда
+        if (sink->idle) {
+            sink->idle(sink->context);
+        }
+        if (count > 0) {
+            continue;
+        }
+        if (!atomic_load(&sink->running)) {
+            break;
+        }
+        waitForSamples(sink);
+    }
+
+    return NULL;
+}
+
+bool TemperatureSinkStart(
+    TemperatureSink *sink, const char *name, size_t queueCapacity, SampleQueuePolicy policy,
+    TemperatureSinkConsume consume, TemperatureSinkIdle idle, void *context
+    ) {
+    sink->name = name;
+    sink->consume = consume;
+    sink->idle = idle;
+    sink->context = context;
+    sink->started = false;
+    sink->stopped = false;
+    atomic_init(&sink->sleeping, false);
+    atomic_init(&sink->running, true);
+
+    if (!SampleQueueInit(&sink->queue, queueCapacity, policy)) {
+        return false;
+    }
+    pthread_mutex_init(&sink->mutex, NULL);
+    pthread_cond_init(&sink->wakeup, NULL);
+
+    if (pthread_create(&sink->thread, NULL, runSink, sink) != 0) {
+        pthread_cond_destroy(&sink->wakeup);
+        pthread_mutex_destroy(&sink->mutex);
+        SampleQueueDestroy(&sink->queue);
+        return false;
+    }
+    sink->started = true;
+    return true;
+}
+
+bool TemperatureSinkPush(TemperatureSink *sink, const TemperatureSample *sample) {
+    bool accepted = SampleQueuePush(&sink->queue, sample);
+
+    // Публикация tail - release, без барьера её может обогнать чтение sleeping
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&sink->sleeping)) {
+        pthread_mutex_lock(&sink->mutex);
+        pthread_cond_signal(&sink->wakeup);
+        pthread_mutex_unlock(&sink->mutex);
+    }
+    return accepted;
+}
+
+void TemperatureSinkStop(TemperatureSink *sink) {
+    if (!sink->started) return;
+
+    pthread_mutex_lock(&sink->mutex);
+    atomic_store(&sink->running, false);
+    pthread_cond_signal(&sink->wakeup);
+    pthread_mutex_unlock(&sink->mutex);
+
+    pthread_join(sink->thread, NULL);
+    sink->started = false;
+    sink->stopped = true;
+}
+
+void TemperatureSinkDestroy(TemperatureSink *sink) {
+    TemperatureSinkStop(sink);
+    if (!sink->stopped) return;
+
+    pthread_cond_destroy(&sink->wakeup);
+    pthread_mutex_destroy(&sink->mutex);
+    SampleQueueDestroy(&sink->queue);
+    sink->stopped = false;
+}
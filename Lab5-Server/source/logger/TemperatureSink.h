@@ -0,0 +1,51 @@
+#ifndef TEMPERATURE_SINK_H
+#define TEMPERATURE_SINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "SampleQueue.h"
+
+#define TEMPERATURE_SINK_BATCH_SIZE 256
+#define TEMPERATURE_SINK_IDLE_MS    100  // как часто сток без данных зовёт idle (сброс по времени и т.п.)
+
+typedef void (*TemperatureSinkConsume)(void *context, const TemperatureSample *samples, size_t count);
+typedef void (*TemperatureSinkIdle)(void *context);
+
+// Сток - отдельный поток, который пачками разбирает свою SPSC-очередь.
+// Поток чтения порта только кладёт отсчёты в очереди и не ждёт диска или БД.
+typedef struct {
+    const char *name;
+    SampleQueue queue;
+    TemperatureSinkConsume consume;
+    TemperatureSinkIdle idle;  // может быть NULL
+    void *context;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t wakeup;
+    atomic_bool sleeping;
+    atomic_bool running;
+    bool started;
+    bool stopped;  // поток завершён, очередь и её счётчики ещё доступны
+} TemperatureSink;
+
+bool TemperatureSinkStart(
+    TemperatureSink *sink,
+    const char *name,
+    size_t queueCapacity,
+    SampleQueuePolicy policy,
+    TemperatureSinkConsume consume,
+    TemperatureSinkIdle idle,
+    void *context
+    );
+
+// Сторона потока чтения
+bool TemperatureSinkPush(TemperatureSink *sink, const TemperatureSample *sample);
+
+// Дожидается, пока сток разберёт остаток очереди, и останавливает поток
+void TemperatureSinkStop(TemperatureSink *sink);
+
+void TemperatureSinkDestroy(TemperatureSink *sink);
+
+#endif // TEMPERATURE_SINK_H
@@ -0,0 +1,101 @@
+#include <string.h>
+
+#include "TimestampFormatter.h"
+
+// Дни от 1970-01-01 до даты и обратно (пролептический григорианский календарь)
+static long long daysFromCivil(long long year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    long long era = (year >= 0 ? year : year - 399) / 400;
+    unsigned yearOfEra = (unsigned)(year - era * 400);
+    unsigned dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + (long long)dayOfEra - 719468;
+}
+
+static void civilFromDays(long long days, int *year, int *month, int *day) {
+    days += 719468;
+    long long era = (days >= 0 ? days : days - 146096) / 146097;
+    unsigned dayOfEra = (unsigned)(days - era * 146097);
+    unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    unsigned monthIndex = (5 * dayOfYear + 2) / 153;
+
+    *day = (int)(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+    *month = (int)(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+    *year = (int)(yearOfEra + era * 400 + (*month <= 2));
+}
+
+static void refreshOffset(TimestampFormatter *formatter, time_t timestamp) {
+    struct tm local;
+#ifdef _WIN32
+    localtime_s(&local, &timestamp);
+#else
+    localtime_r(&timestamp, &local);
+#endif
+
+    long long localSeconds = daysFromCivil(local.tm_year + 1900, (unsigned)local.tm_mon + 1, (unsigned)local.tm_mday) * 86400 +
+                             local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec;
+    formatter->utcOffset = (long)(localSeconds - (long long)timestamp);
+    formatter->offsetFrom = timestamp - (local.tm_min * 60 + local.tm_sec);
+    formatter->offsetUntil = formatter->offsetFrom + 3600;
+    formatter->offsetLookups++;
+}
+
+static void putDigits(char *text, int value, int width) {
+    for (int i = width - 1; i >= 0; i--) {
+        text[i] = (char)('0' + value % 10);
+        value /= 10;
+    }
+}
+
+void TimestampFormatterInit(TimestampFormatter *formatter) {
+    memset(formatter, 0, sizeof(*formatter));
+    formatter->minuteStart = -1;
+}
+
+void TimestampToLocal(TimestampFormatter *formatter, time_t timestamp, struct tm *local) {
+    if (formatter->offsetUntil == 0 || timestamp < formatter->offsetFrom || timestamp >= formatter->offsetUntil) {
+        refreshOffset(formatter, timestamp);
+    }
+
+    long long seconds = (long long)timestamp + formatter->utcOffset;
+    long long days = (seconds >= 0 ? seconds : seconds - 86399) / 86400;
+    long long secondOfDay = seconds - days * 86400;
+
+    memset(local, 0, sizeof(*local));
+    int year, month, day;
+    civilFromDays(days, &year, &month, &day);
+    local->tm_year = year - 1900;
+    local->tm_mon = month - 1;
+    local->tm_mday = day;
+    local->tm_hour = (int)(secondOfDay / 3600);
+    local->tm_min = (int)(secondOfDay / 60 % 60);
+    local->tm_sec = (int)(secondOfDay % 60);
+    local->tm_isdst = -1;
+}
+
+void TimestampFormat(TimestampFormatter *formatter, time_t timestamp, char *text) {
+    if (formatter->minuteStart < 0 || timestamp < formatter->minuteStart || timestamp >= formatter->minuteStart + 60) {
+        struct tm local;
+        TimestampToLocal(formatter, timestamp, &local);
+        char *prefix = formatter->prefix;
+        putDigits(prefix, local.tm_year + 1900, 4);
+        prefix[4] = '-';
+        putDigits(prefix + 5, local.tm_mon + 1, 2);
+        prefix[7] = '-';
+        putDigits(prefix + 8, local.tm_mday, 2);
+        prefix[10] = ' ';
+        putDigits(prefix + 11, local.tm_hour, 2);
+        prefix[13] = ':';
+        putDigits(prefix + 14, local.tm_min, 2);
+        prefix[16] = ':';
+        formatter->minuteStart = timestamp - local.tm_sec;
+        formatter->renders++;
+    }
+
+    int second = (int)(timestamp - formatter->minuteStart);
+    memcpy(text, formatter->prefix, TIMESTAMP_PREFIX_SIZE);
+    text[TIMESTAMP_PREFIX_SIZE] = (char)('0' + second / 10);
+    text[TIMESTAMP_PREFIX_SIZE + 1] = (char)('0' + second % 10);
+    text[TIMESTAMP_PREFIX_SIZE + 2] = '\0';
+}
@@ -0,0 +1,31 @@
+#ifndef TIMESTAMP_FORMATTER_H
+#define TIMESTAMP_FORMATTER_H
+
+#include <time.h>
+
+#define TIMESTAMP_TEXT_SIZE   20  // "YYYY-MM-DD HH:MM:SS" + '\0'
+#define TIMESTAMP_PREFIX_SIZE 17  // "YYYY-MM-DD HH:MM:"
+
+// Форматирование меток времени для горячего пути записи. Префикс до минут кэшируется,
+// на каждую запись дописываются только секунды. Смещение пояса берётся из localtime_r
+// раз в час (переводы часов бывают только на границе часа), в остальное время местное
+// время считается арифметикой. У каждого потока должен быть свой экземпляр.
+typedef struct {
+    time_t minuteStart;  // -1 - кэш префикса пуст
+    char prefix[TIMESTAMP_TEXT_SIZE];
+    time_t offsetFrom;   // смещение utcOffset верно для [offsetFrom, offsetUntil)
+    time_t offsetUntil;
+    long utcOffset;
+    unsigned long long renders;
+    unsigned long long offsetLookups;
+} TimestampFormatter;
+
+void TimestampFormatterInit(TimestampFormatter *formatter);
+
+// Заполняет в local дату и время (tm_year .. tm_sec) по местному поясу без localtime
+void TimestampToLocal(TimestampFormatter *formatter, time_t timestamp, struct tm *local);
+
+// Пишет в text "YYYY-MM-DD HH:MM:SS" (TIMESTAMP_TEXT_SIZE байт вместе с '\0')
+void TimestampFormat(TimestampFormatter *formatter, time_t timestamp, char *text);
+
+#endif // TIMESTAMP_FORMATTER_H
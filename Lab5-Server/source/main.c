@@ -4,6 +4,7 @@
 
 #include "logger/SerialPort.h"
 #include "logger/TemperatureDeviceSimulator.h"
+#include "logger/TemperatureFleetSimulator.h"
 #include "logger/TemperatureLogger.h"
 
 #include "database/Database.h"
@@ -26,13 +27,101 @@
 #endif
 
 #define BAUD_RATE       9600
+#define SENSOR_PROTOCOL SENSOR_PROTOCOL_TEXT
 #define LOG_FILE        "TemperatureLog.txt"
 #define HOURLY_LOG_FILE "HourAvg.txt"
 #define DAILY_LOG_FILE  "DayAvg.txt"
+#define COMPRESSED_LOG_FILE ""  // "TemperatureLog.tsl" - писать отсчёты в сжатый двоичный лог вместо текстового
+#define CHECKPOINT_FILE "Aggregates.checkpoint"
+#define LOG_RETENTION_HOURS 0  // > 0 - записи старше стольких часов удаляются из логов
+#define LOG_SEGMENT_MAX_BYTES 0  // > 0 - часовой сегмент лога отсчётов дополнительно делится по размеру
+#define DATABASE_RETENTION_HOURS 0  // > 0 - месячные разделы БД старше стольких часов удаляются
+
+#define SENSOR_ID 1
+#define SIMULATOR_SEED     0    // != 0 - воспроизводимая последовательность значений
+#define SAMPLES_PER_SECOND 0.0  // > 0 - нагрузочный режим с точным темпом вместо интервала в 1 с
+
+#define REPLAY_TRACE_FILE ""    // путь к записанному TemperatureLog.txt или выгрузке БД - проиграть его вместо генерации
+#define REPLAY_FROM       0     // unix-время начала и конца проигрываемого отрезка; 0 - без границы
+#define REPLAY_TO         0
+#define REPLAY_SPEED      60.0  // во сколько раз быстрее реального времени; 0 - без пауз
+
+#define FLEET_DEVICES            0  // > 0 - вместо одного симулятора запускается парк устройств
+#define FLEET_WORKERS            4
+#define FLEET_SAMPLES_PER_SECOND 10.0
+
+#define SERIAL_TRANSPORT_DEVICE 0  // порты WRITE_PORT/READ_PORT (socat, COM-порты)
+#define SERIAL_TRANSPORT_PTY    1  // собственная пара псевдотерминалов
+#define SERIAL_TRANSPORT_MEMORY 2  // канал в памяти без TTY
+
+#ifdef _WIN32
+    #define SERIAL_TRANSPORT SERIAL_TRANSPORT_DEVICE
+#else
+    #define SERIAL_TRANSPORT SERIAL_TRANSPORT_PTY
+#endif
+
+
+static bool openSerialTransport(SerialPort **simulatorPort, SerialPort **loggerPort) {
+#if SERIAL_TRANSPORT == SERIAL_TRANSPORT_PTY
+    return SerialOpenPtyPair(BAUD_RATE, simulatorPort, loggerPort);
+#elif SERIAL_TRANSPORT == SERIAL_TRANSPORT_MEMORY
+    return SerialOpenMemoryChannel(SERIAL_CHANNEL_CAPACITY, simulatorPort, loggerPort);
+#else
+    *simulatorPort = SerialOpen(WRITE_PORT, BAUD_RATE);
+    *loggerPort = SerialOpen(READ_PORT, BAUD_RATE);
+    if (!*simulatorPort || !*loggerPort) {
+        SerialClose(*simulatorPort);
+        SerialClose(*loggerPort);
+        return false;
+    }
+    return true;
+#endif
+}
+
+
+#if FLEET_DEVICES > 0
+static TemperatureFleetSimulator* startFleet(TemperatureLoggerPortConfig *loggerPorts) {
+    static TemperatureFleetDeviceConfig devices[FLEET_DEVICES];
+
+    for (size_t i = 0; i < FLEET_DEVICES; i++) {
+        SerialPort *simulatorPort, *loggerPort;
+        if (!openSerialTransport(&simulatorPort, &loggerPort)) {
+            return NULL;
+        }
+
+        // Разброс темпа и сглаживания, чтобы нагрузка не шла синхронными волнами
+        devices[i].serialPort = simulatorPort;
+        devices[i].portName = simulatorPort->portName;
+        devices[i].sensorId = SENSOR_ID + i;
+        devices[i].samplesPerSecond = FLEET_SAMPLES_PER_SECOND * (1.0 + (i % 5) * 0.25);
+        devices[i].alpha = 0.05 + (i % 10) * 0.02;
+        devices[i].minTemperature = -20.0;
+        devices[i].maxTemperature = 20.0;
+        devices[i].seed = SIMULATOR_SEED ? SIMULATOR_SEED + i : 0;
+
+        loggerPorts[i].portName = loggerPort->portName;
+        loggerPorts[i].sensorId = SENSOR_ID + i;
+        loggerPorts[i].serialPort = loggerPort;
+    }
+
+    TemperatureFleetSimulator *fleet = TemperatureFleetSimulatorInit(devices, FLEET_DEVICES, FLEET_WORKERS, BAUD_RATE, SENSOR_PROTOCOL);
+    if (!fleet || !TemperatureFleetSimulatorStart(fleet)) {
+        TemperatureFleetSimulatorClose(fleet);
+        return NULL;
+    }
+    return fleet;
+}
+#endif
 
 
 void *runTemperatureSimulator(void *arg) {
     TemperatureDeviceSimulator *simulator = (TemperatureDeviceSimulator *)arg;
+#ifndef _WIN32
+    if (REPLAY_TRACE_FILE[0] != '\0') {
+        TemperatureDeviceSimulatorReplay(simulator, REPLAY_TRACE_FILE, REPLAY_FROM, REPLAY_TO, REPLAY_SPEED);
+        return NULL;
+    }
+#endif
     TemperatureDeviceSimulatorRun(simulator);
     return NULL;
 }
@@ -47,9 +136,28 @@ void *runTemperatureLogger(void *arg) {
 int main(int argc, char *argv[]) {
     printf("Запуск эмулятора температуры, логгера и сервера...\n");
 
-    TemperatureDeviceSimulator* simulator = TemperatureDeviceSimulatorInit(
-        WRITE_PORT,
-        BAUD_RATE,
+    if (!database_init(DatabaseFile)) {
+        fprintf(stderr, "Ошибка: не удалось инициализировать БД\n");
+        return EXIT_FAILURE;
+    }
+
+#if FLEET_DEVICES > 0
+    static TemperatureLoggerPortConfig loggerPorts[FLEET_DEVICES];
+
+    TemperatureFleetSimulator *fleet = startFleet(loggerPorts);
+    if (!fleet) {
+        fprintf(stderr, "Ошибка: не удалось запустить парк симуляторов\n");
+        return EXIT_FAILURE;
+    }
+#else
+    SerialPort *simulatorPort, *loggerPort;
+    if (!openSerialTransport(&simulatorPort, &loggerPort)) {
+        fprintf(stderr, "Ошибка: не удалось открыть порты\n");
+        return EXIT_FAILURE;
+    }
+
+    TemperatureDeviceSimulator* simulator = TemperatureDeviceSimulatorInitWithPort(
+        simulatorPort,
         -20.0,
         20.0,
         0.12,
@@ -60,6 +168,12 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "Ошибка: не удалось инициализировать симулятор\n");
         return EXIT_FAILURE;
     }
+    simulator->protocol = SENSOR_PROTOCOL;
+    simulator->sensorId = SENSOR_ID;
+    simulator->samplesPerSecond = SAMPLES_PER_SECOND;
+    if (SIMULATOR_SEED) {
+        TemperatureDeviceSimulatorSeed(simulator, SIMULATOR_SEED);
+    }
 
     pthread_t simulatorThread;
     if (pthread_create(&simulatorThread, NULL, runTemperatureSimulator, simulator) != 0) {
@@ -67,18 +181,33 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
+    TemperatureLoggerPortConfig loggerPorts[] = {
+        { READ_PORT, SENSOR_ID, loggerPort },
+    };
+#endif
+
     TemperatureLogger* logger = TemperatureLoggerInit(
-        READ_PORT,
+        loggerPorts,
+        sizeof(loggerPorts) / sizeof(loggerPorts[0]),
         BAUD_RATE,
         LOG_FILE,
         HOURLY_LOG_FILE,
-        DAILY_LOG_FILE
+        DAILY_LOG_FILE,
+        NULL
     );
 
     if (!logger) {
         fprintf(stderr, "Ошибка: не удалось инициализировать логгер\n");
         return EXIT_FAILURE;
     }
+    logger->protocol = SENSOR_PROTOCOL;
+    logger->retentionHours = LOG_RETENTION_HOURS;
+    logger->log.maxSegmentBytes = LOG_SEGMENT_MAX_BYTES;
+    logger->databaseRetentionHours = DATABASE_RETENTION_HOURS;
+    TemperatureLoggerRestoreCheckpoint(logger, CHECKPOINT_FILE);
+    if (COMPRESSED_LOG_FILE[0] != '\0' && !TemperatureLoggerUseCompressedLog(logger, COMPRESSED_LOG_FILE)) {
+        return EXIT_FAILURE;
+    }
 
     pthread_t loggerThread;
     if (pthread_create(&loggerThread, NULL, runTemperatureLogger, logger) != 0) {
@@ -86,23 +215,26 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
-    if (!database_init(DatabaseFile)) {
-        fprintf(stderr, "Ошибка: не удалось инициализировать БД\n");
-        return EXIT_FAILURE;
-    }
-
     if (!http_server_start(HttpUrl, PoolTimeoutMs)) {
         fprintf(stderr, "Ошибка: не удалось запустить HTTP-сервер\n");
         database_close();
         return EXIT_FAILURE;
     }
 
+#if FLEET_DEVICES > 0
+    TemperatureFleetSimulatorClose(fleet);
+#else
     pthread_join(simulatorThread, NULL);
+#endif
+    TemperatureLoggerStop(logger);
     pthread_join(loggerThread, NULL);
 
+    database_print_stats();
     database_close();
     
+#if FLEET_DEVICES == 0
     TemperatureDeviceSimulatorClose(simulator);
+#endif
     TemperatureLoggerClose(logger);
 
     printf("Работа эмулятора температуры, логгера и сервера завершена.\n");
@@ -0,0 +1,307 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "Downsample.h"
+
+
+bool DownsampleParseMode(const char *name, DownsampleMode *mode) {
+    static const struct { const char *name; DownsampleMode mode; } modes[] = {
+        { "none", DOWNSAMPLE_NONE },
+        { "lttb", DOWNSAMPLE_LTTB },
+        { "minmax", DOWNSAMPLE_MINMAX },
+        { "avg", DOWNSAMPLE_AVG },
+    };
+
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        if (strcmp(name, modes[i].name) == 0) {
+            *mode = modes[i].mode;
+            return true;
+        }
+    }
+    return false;
+}
+
+void DownsamplerInit(Downsampler *downsampler, DownsampleMode mode, int maxPoints, long long from, long long to,
+                     TemperatureRecordVisitor emit, void *emitContext) {
+    memset(downsampler, 0, sizeof(Downsampler));
+    downsampler->mode = (maxPoints > 0) ? mode : DOWNSAMPLE_NONE;
+    downsampler->from = from;
+    downsampler->to = (to > from) ? to : from;
+    downsampler->emit = emit;
+    downsampler->emitContext = emitContext;
+
+    // minmax даёт две точки на корзину, lttb отдельно сохраняет первую и последнюю
+    switch (downsampler->mode) {
+        case DOWNSAMPLE_MINMAX: downsampler->buckets = maxPoints / 2; break;
+        case DOWNSAMPLE_LTTB:   downsampler->buckets = maxPoints - 2; break;
+        default:                downsampler->buckets = maxPoints; break;
+    }
+    if (downsampler->buckets < 1) {
+        downsampler->buckets = 1;
+    }
+}
+
+static void emitPoint(Downsampler *downsampler, const TemperatureRecord *record) {
+    if (downsampler->stopped) {
+        return;
+    }
+    if (!downsampler->emit(downsampler->emitContext, record)) {
+        downsampler->stopped = true;
+        return;
+    }
+    downsampler->output++;
+}
+
+static long long bucketOf(const Downsampler *downsampler, long long timestamp) {
+    if (timestamp <= downsampler->from) return 0;
+    if (timestamp >= downsampler->to) return downsampler->buckets - 1;
+    return (timestamp - downsampler->from) * downsampler->buckets / (downsampler->to - downsampler->from + 1);
+}
+
+static DownsampleSeries* findSeries(Downsampler *downsampler, int sensor) {
+    for (int i = 0; i < downsampler->seriesCount; i++) {
+        if (downsampler->series[i].sensor == sensor) {
+            return &downsampler->series[i];
+        }
+    }
+
+    if (downsampler->seriesCount == downsampler->seriesCapacity) {
+        int capacity = downsampler->seriesCapacity ? downsampler->seriesCapacity * 2 : 4;
+        DownsampleSeries *series = realloc(downsampler->series, capacity * sizeof(DownsampleSeries));
+        if (!series) {
+            return NULL;
+        }
+        downsampler->series = series;
+        downsampler->seriesCapacity = capacity;
+    }
+
+    DownsampleSeries *series = &downsampler->series[downsampler->seriesCount++];
+    memset(series, 0, sizeof(DownsampleSeries));
+    series->sensor = sensor;
+    series->bucket = -1;
+    return series;
+}
+
+static bool appendPoint(DownsamplePoints *points, const TemperatureRecord *record) {
+    if (points->count == points->capacity) {
+        int capacity = points->capacity ? points->capacity * 2 : 64;
+        TemperatureRecord *grown = realloc(points->points, capacity * sizeof(TemperatureRecord));
+        if (!grown) {
+            return false;
+        }
+        points->points = grown;
+        points->capacity = capacity;
+    }
+    points->points[points->count++] = *record;
+    return true;
+}
+
+
+// avg и minmax: корзине достаточно сумм и крайних точек
+
+static void closeAggregateBucket(Downsampler *downsampler, DownsampleSeries *series) {
+    if (series->count == 0) {
+        return;
+    }
+
+    if (downsampler->mode == DOWNSAMPLE_AVG) {
+        TemperatureRecord average = {
+            .timestamp = (int)llround(series->timeSum / series->count),
+            .temperature = series->sum / series->count,
+            .sensor = series->sensor
+        };
+        emitPoint(downsampler, &average);
+    } else {
+        const TemperatureRecord *first = &series->min, *second = &series->max;
+        if (second->timestamp < first->timestamp) {
+            first = &series->max;
+            second = &series->min;
+        }
+        emitPoint(downsampler, first);
+        if (series->count > 1 && (first->timestamp != second->timestamp || first->temperature != second->temperature)) {
+            emitPoint(downsampler, second);
+        }
+    }
+    series->count = 0;
+    series->sum = 0.0;
+    series->timeSum = 0.0;
+}
+
+// weight отсчётов со значениями от low до high и суммой sum, приходящихся на время low/high
+static void addAggregate(Downsampler *downsampler, DownsampleSeries *series, const TemperatureRecord *low,
+                         const TemperatureRecord *high, long long weight, double sum) {
+    long long bucket = bucketOf(downsampler, low->timestamp);
+    if (series->count > 0 && bucket != series->bucket) {
+        closeAggregateBucket(downsampler, series);
+    }
+    series->bucket = bucket;
+
+    if (series->count == 0 || low->temperature < series->min.temperature) {
+        series->min = *low;
+    }
+    if (series->count == 0 || high->temperature > series->max.temperature) {
+        series->max = *high;
+    }
+    series->count += weight;
+    series->sum += sum;
+    series->timeSum += (double)low->timestamp * weight;
+}
+
+
+// lttb: из корзины выбирается точка с наибольшей площадью треугольника между уже выбранной
+// точкой предыдущей корзины и средним следующей, поэтому в памяти держатся только две корзины
+
+static int selectLargestTriangle(const DownsamplePoints *points, const TemperatureRecord *previous,
+                                 double nextTime, double nextValue) {
+    int selected = 0;
+    double largest = -1.0;
+
+    for (int i = 0; i < points->count; i++) {
+        double area = fabs((previous->timestamp - nextTime) * (points->points[i].temperature - previous->temperature)
+                         - (previous->timestamp - (double)points->points[i].timestamp) * (nextValue - previous->temperature));
+        if (area > largest) {
+            largest = area;
+            selected = i;
+        }
+    }
+    return selected;
+}
+
+static void selectPending(Downsampler *downsampler, DownsampleSeries *series, double nextTime, double nextValue) {
+    if (series->pending.count == 0) {
+        return;
+    }
+    int selected = selectLargestTriangle(&series->pending, &series->selected, nextTime, nextValue);
+    series->selected = series->pending.points[selected];
+    emitPoint(downsampler, &series->selected);
+}
+
+static void closeLttbBucket(Downsampler *downsampler, DownsampleSeries *series) {
+    double timeSum = 0.0, valueSum = 0.0;
+    for (int i = 0; i < series->current.count; i++) {
+        timeSum += series->current.points[i].timestamp;
+        valueSum += series->current.points[i].temperature;
+    }
+    selectPending(downsampler, series, timeSum / series->current.count, valueSum / series->current.count);
+
+    DownsamplePoints swap = series->pending;
+    series->pending = series->current;
+    series->current = swap;
+    series->current.count = 0;
+}
+
+static void addLttb(Downsampler *downsampler, DownsampleSeries *series, const TemperatureRecord *record) {
+    if (!series->hasSelected) {
+        series->selected = *record;
+        series->hasSelected = true;
+        emitPoint(downsampler, record);
+        return;
+    }
+
+    long long bucket = bucketOf(downsampler, record->timestamp);
+    if (series->current.count > 0 && bucket != series->bucket) {
+        closeLttbBucket(downsampler, series);
+    }
+    series->bucket = bucket;
+
+    if (!appendPoint(&series->current, record)) {
+        downsampler->stopped = true;
+        return;
+    }
+    series->last = *record;
+}
+
+static void finishLttb(Downsampler *downsampler, DownsampleSeries *series) {
+    if (series->current.count > 0) {
+        closeLttbBucket(downsampler, series);
+    }
+    if (series->pending.count == 0) {
+        return;
+    }
+
+    // Последняя корзина выбирает точку относительно последнего отсчёта, который сохраняется всегда
+    int selected = selectLargestTriangle(&series->pending, &series->selected,
+                                         series->last.timestamp, series->last.temperature);
+    emitPoint(downsampler, &series->pending.points[selected]);
+    if (selected != series->pending.count - 1) {
+        emitPoint(downsampler, &series->last);
+    }
+    series->pending.count = 0;
+}
+
+
+bool DownsamplerAdd(void *context, const TemperatureRecord *record) {
+    Downsampler *downsampler = (Downsampler *)context;
+    downsampler->input++;
+
+    if (downsampler->mode == DOWNSAMPLE_NONE) {
+        emitPoint(downsampler, record);
+        return !downsampler->stopped;
+    }
+
+    DownsampleSeries *series = findSeries(downsampler, record->sensor);
+    if (!series) {
+        downsampler->stopped = true;
+        return false;
+    }
+
+    if (downsampler->mode == DOWNSAMPLE_LTTB) {
+        addLttb(downsampler, series, record);
+    } else {
+        addAggregate(downsampler, series, record, record, 1, record->temperature);
+    }
+    return !downsampler->stopped;
+}
+
+bool DownsamplerAddRollup(void *context, const TemperatureRollup *rollup) {
+    Downsampler *downsampler = (Downsampler *)context;
+    downsampler->input++;
+
+    int middle = (int)((rollup->bucket_start + rollup->bucket_end) / 2);
+    TemperatureRecord mean = { .timestamp = middle, .temperature = rollup->mean, .sensor = rollup->sensor };
+    if (downsampler->mode == DOWNSAMPLE_NONE) {
+        emitPoint(downsampler, &mean);
+        return !downsampler->stopped;
+    }
+
+    DownsampleSeries *series = findSeries(downsampler, rollup->sensor);
+    if (!series) {
+        downsampler->stopped = true;
+        return false;
+    }
+
+    TemperatureRecord low = { .timestamp = middle, .temperature = rollup->min, .sensor = rollup->sensor };
+    TemperatureRecord high = { .timestamp = middle, .temperature = rollup->max, .sensor = rollup->sensor };
+    if (downsampler->mode == DOWNSAMPLE_LTTB) {
+        // Среднее сгладило бы выбросы внутри агрегата - кандидатами идут его минимум и максимум
+        addLttb(downsampler, series, &low);
+        if (rollup->max != rollup->min) {
+            addLttb(downsampler, series, &high);
+        }
+    } else {
+        addAggregate(downsampler, series, &low, &high, rollup->count, rollup->sum);
+    }
+    return !downsampler->stopped;
+}
+
+void DownsamplerFinish(Downsampler *downsampler) {
+    for (int i = 0; i < downsampler->seriesCount; i++) {
+        if (downsampler->mode == DOWNSAMPLE_LTTB) {
+            finishLttb(downsampler, &downsampler->series[i]);
+        } else {
+            closeAggregateBucket(downsampler, &downsampler->series[i]);
+        }
+    }
+}
+
+void DownsamplerClose(Downsampler *downsampler) {
+    for (int i = 0; i < downsampler->seriesCount; i++) {
+        free(downsampler->series[i].pending.points);
+        free(downsampler->series[i].current.points);
+    }
+    free(downsampler->series);
+    downsampler->series = NULL;
+    downsampler->seriesCount = 0;
+    downsampler->seriesCapacity = 0;
+}
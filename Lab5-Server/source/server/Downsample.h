@@ -0,0 +1,79 @@
+#ifndef DOWNSAMPLE_H
+#define DOWNSAMPLE_H
+
+#include <stdbool.h>
+
+#include "../database/Database.h"
+
+// Прореживание ряда за один проход по выборке: период [from, to] делится по времени
+// на корзины, из каждой корзины остаётся одна-две точки. Датчики прореживаются раздельно.
+typedef enum {
+    DOWNSAMPLE_NONE,    // все строки как есть
+    DOWNSAMPLE_LTTB,    // Largest-Triangle-Three-Buckets: точка с наибольшей площадью треугольника
+    DOWNSAMPLE_MINMAX,  // минимум и максимум корзины в порядке времени
+    DOWNSAMPLE_AVG      // среднее корзины
+} DownsampleMode;
+
+typedef struct {
+    TemperatureRecord *points;
+    int count;
+    int capacity;
+} DownsamplePoints;
+
+typedef struct {
+    int sensor;
+    long long bucket;           // индекс собираемой корзины, -1 - точек ещё не было
+
+    // avg, minmax
+    long long count;
+    double sum;
+    double timeSum;
+    TemperatureRecord min;
+    TemperatureRecord max;
+
+    // lttb: корзина pending ждёт, пока соберётся следующая (current), чтобы выбрать точку
+    TemperatureRecord selected;
+    bool hasSelected;
+    DownsamplePoints pending;
+    DownsamplePoints current;
+    TemperatureRecord last;
+} DownsampleSeries;
+
+typedef struct {
+    DownsampleMode mode;
+    long long from;
+    long long to;
+    long long buckets;
+
+    TemperatureRecordVisitor emit;
+    void *emitContext;
+    bool stopped;               // emit вернул false или не хватило памяти
+
+    DownsampleSeries *series;
+    int seriesCount;
+    int seriesCapacity;
+
+    unsigned long long input;
+    unsigned long long output;
+} Downsampler;
+
+// Разбирает "lttb", "minmax", "avg" или "none"
+bool DownsampleParseMode(const char *name, DownsampleMode *mode);
+
+// maxPoints - предел числа точек на датчик; <= 0 или DOWNSAMPLE_NONE - без прореживания
+void DownsamplerInit(Downsampler *downsampler, DownsampleMode mode, int maxPoints, long long from, long long to,
+                     TemperatureRecordVisitor emit, void *emitContext);
+
+// Подходит как TemperatureRecordVisitor для database_foreach_temperature; строки - по возрастанию времени
+bool DownsamplerAdd(void *downsampler, const TemperatureRecord *record);
+
+// То же для готового агрегата: avg взвешивает его по числу отсчётов, minmax и lttb берут его
+// минимум и максимум (lttb - как две точки-кандидата); точкой агрегата считается середина его корзины
+bool DownsamplerAddRollup(void *downsampler, const TemperatureRollup *rollup);
+
+// Выдаёт точки незакрытых корзин
+void DownsamplerFinish(Downsampler *downsampler);
+
+void DownsamplerClose(Downsampler *downsampler);
+
+#endif // DOWNSAMPLE_H
@@ -4,6 +4,7 @@
 #include "cJSON.h"
 
 #include "../database/Database.h"
+#include "Downsample.h"
 #include "Server.h"
 
 # define GET                    mg_str("GET")
@@ -17,6 +18,8 @@
 # define ResponceJsonHeader     "Access-Control-Allow-Origin: *\r\nContent-Type: application/json\r\n"
 # define ResponceTextHeader     "Access-Control-Allow-Origin: *\r\nContent-Type: text/plain\r\n"
 
+# define MAX_DOWNSAMPLE_POINTS  100000
+
 
 static struct mg_mgr connectionManager;
 static struct mg_connection *connections;
@@ -47,6 +50,64 @@ static int is_valid_date(const char *date) { //Format: YYYY-MM-DD
 }
 
 
+// Необязательные maxPoints и mode (lttb по умолчанию). false - неверное значение
+static bool parseDownsampling(struct mg_str query, DownsampleMode *mode, int *maxPoints) {
+    char maxPointsString[12], modeString[12];
+    *mode = DOWNSAMPLE_NONE;
+    *maxPoints = 0;
+
+    if (mg_http_get_var(&query, "maxPoints", maxPointsString, sizeof(maxPointsString)) <= 0) {
+        return true;
+    }
+
+    char *endptr;
+    long value = strtol(maxPointsString, &endptr, 10);
+    if (*endptr != '\0' || value < 1 || value > MAX_DOWNSAMPLE_POINTS) {
+        return false;
+    }
+    *maxPoints = (int)value;
+    *mode = DOWNSAMPLE_LTTB;
+
+    if (mg_http_get_var(&query, "mode", modeString, sizeof(modeString)) > 0) {
+        return DownsampleParseMode(modeString, mode);
+    }
+    return true;
+}
+
+
+// Разрешение агрегатов для окна window секунд или -1 - нужны сырые строки
+static int chooseRollupResolution(const Downsampler *downsampler, long long window) {
+    if (downsampler->mode == DOWNSAMPLE_NONE) {
+        return -1;
+    }
+    for (int resolution = DATABASE_ROLLUP_DAY; resolution >= DATABASE_ROLLUP_MINUTE; resolution--) {
+        if (window / database_rollup_seconds(resolution) >= downsampler->buckets) {
+            return resolution;
+        }
+    }
+    return -1;
+}
+
+
+// Необязательный параметр sensor; без него - defaultSensor. false - значение не число
+static bool parseSensor(struct mg_str source, int defaultSensor, int *sensor) {
+    char sensorString[12];
+    *sensor = defaultSensor;
+
+    if (mg_http_get_var(&source, "sensor", sensorString, sizeof(sensorString)) <= 0) {
+        return true;
+    }
+
+    char *endptr;
+    long value = strtol(sensorString, &endptr, 10);
+    if (*endptr != '\0' || value < 0 || value > 65535) {
+        return false;
+    }
+    *sensor = (int)value;
+    return true;
+}
+
+
 static char *SerializeTemperaturesToJson(TemperatureRecord *records, int count) {
     cJSON *root = cJSON_CreateArray();
 
@@ -54,6 +115,7 @@ static char *SerializeTemperaturesToJson(TemperatureRecord *records, int count)
         cJSON *entry = cJSON_CreateObject();
         cJSON_AddNumberToObject(entry, "timestamp", records[i].timestamp);
         cJSON_AddNumberToObject(entry, "temperature", records[i].temperature);
+        cJSON_AddNumberToObject(entry, "sensor", records[i].sensor);
         cJSON_AddItemToArray(root, entry);
     }
 
@@ -63,6 +125,20 @@ static char *SerializeTemperaturesToJson(TemperatureRecord *records, int count)
 }
 
 
+// Строки выборки сразу добавляются в JSON-массив, без промежуточного массива записей
+static bool appendTemperatureJson(void *context, const TemperatureRecord *record) {
+    cJSON *entry = cJSON_CreateObject();
+    if (!entry) {
+        return false;
+    }
+    cJSON_AddNumberToObject(entry, "timestamp", record->timestamp);
+    cJSON_AddNumberToObject(entry, "temperature", record->temperature);
+    cJSON_AddNumberToObject(entry, "sensor", record->sensor);
+    cJSON_AddItemToArray((cJSON *)context, entry);
+    return true;
+}
+
+
 static void handleTemperatureGetLast(struct mg_connection *connection, struct mg_http_message* message) {
 
     int count;
@@ -97,19 +173,54 @@ static void handleTemperatureGetByDates(struct mg_connection *connection, struct
         return;
     }
 
-    int count;
-    TemperatureRecord *records = database_get_temperatures(startDate, endDate, &count);
+    int sensor;
+    if (!parseSensor(message->query, -1, &sensor)) {
+        mg_http_reply(connection, 400, ResponceJsonHeader, "Error: Invalid format for 'sensor'\n");
+        return;
+    }
 
-    if (!records) {
+    DownsampleMode mode;
+    int maxPoints;
+    if (!parseDownsampling(message->query, &mode, &maxPoints)) {
+        mg_http_reply(connection, 400, ResponceJsonHeader, "Error: Invalid format for 'maxPoints' or 'mode'\n");
+        return;
+    }
+
+    // Прореживание идёт в том же проходе по выборке, до сериализации
+    long long from = database_date_to_epoch(startDate), to = database_date_to_epoch(endDate) + 86399;
+    cJSON *root = cJSON_CreateArray();
+    Downsampler downsampler;
+    DownsamplerInit(&downsampler, mode, maxPoints, from, to, appendTemperatureJson, root);
+
+    // Самые крупные агрегаты, которых ещё хватает на бюджет точек, вместо сырых строк
+    int count = -1;
+    int resolution = chooseRollupResolution(&downsampler, to - from + 1);
+    if (resolution >= 0) {
+        count = database_foreach_rollup(resolution, from, to, sensor, DownsamplerAddRollup, &downsampler);
+        if (count < 0 && downsampler.input > 0) {
+            cJSON_Delete(root);
+            root = cJSON_CreateArray();
+            DownsamplerClose(&downsampler);
+            DownsamplerInit(&downsampler, mode, maxPoints, from, to, appendTemperatureJson, root);
+        }
+    }
+    if (count < 0) {
+        count = database_foreach_temperature(startDate, endDate, sensor, DownsamplerAdd, &downsampler);
+    }
+    DownsamplerFinish(&downsampler);
+    DownsamplerClose(&downsampler);
+
+    if (count <= 0) {
+        cJSON_Delete(root);
         mg_http_reply(connection, 404, ResponceJsonHeader, "{\"error\":\"No data found\"}");
         return;
     }
 
-    char *json_response = SerializeTemperaturesToJson(records, count);
+    char *json_response = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
     MG_INFO(("Responding with success"));
     mg_http_reply(connection, 200, ResponceJsonHeader, json_response);
     free(json_response);
-    free(records);
 }
 
 
@@ -132,7 +243,13 @@ static void handleTemperatureSet(struct mg_connection *connection, struct mg_htt
         return;
     }
 
-    if (!database_insert_temperature(temperature)) {
+    int sensor;
+    if (!parseSensor(message->body, 0, &sensor)) {
+        mg_http_reply(connection, 400, ResponceJsonHeader, "Error: Invalid format for 'sensor'\n");
+        return;
+    }
+
+    if (!database_insert_temperature(sensor, temperature)) {
         mg_http_reply(connection, 400, ResponceJsonHeader, "Error: Couldn't make an entry\n");
         return;
     }
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "logger/CompressedLog.h"
+#include "logger/TimestampFormatter.h"
+
+// Конвертер между текстовым логом ("YYYY-MM-DD HH:MM:SS value [sensorId]") и сжатым двоичным:
+//   logconvert to-binary TemperatureLog.txt TemperatureLog.tsl
+//   logconvert to-text TemperatureLog.tsl TemperatureLog.txt [fromEpoch toEpoch [sensorId]]
+
+static long long fileBytes(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return 0;
+    fseek(file, 0, SEEK_END);
+    long long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+static int toBinary(const char *inputPath, const char *outputPath) {
+    FILE *input = fopen(inputPath, "r");
+    if (!input) {
+        perror("Ошибка открытия текстового лога.\n");
+        return EXIT_FAILURE;
+    }
+
+    CompressedLog log;
+    if (!CompressedLogOpen(&log, outputPath)) {
+        perror("Ошибка открытия сжатого лога.\n");
+        fclose(input);
+        return EXIT_FAILURE;
+    }
+
+    // mktime дорогой - пересчитываем начало часа только при его смене
+    char line[256];
+    char cachedHour[14] = "";
+    time_t hourStart = 0;
+    unsigned long long skipped = 0;
+
+    while (fgets(line, sizeof(line), input)) {
+        struct tm entryTime = {0};
+        double temperature;
+        unsigned sensorId = 0;
+
+        int fields = sscanf(line, "%4d-%2d-%2d %2d:%2d:%2d %lf %u",
+                            &entryTime.tm_year, &entryTime.tm_mon, &entryTime.tm_mday,
+                            &entryTime.tm_hour, &entryTime.tm_min, &entryTime.tm_sec, &temperature, &sensorId);
+        if (fields < 7) {
+            skipped++;
+            continue;
+        }
+
+        if (strncmp(line, cachedHour, 13) != 0) {
+            int minutes = entryTime.tm_min, seconds = entryTime.tm_sec;
+            entryTime.tm_year -= 1900;
+            entryTime.tm_mon -= 1;
+            entryTime.tm_min = entryTime.tm_sec = 0;
+            entryTime.tm_isdst = -1;
+            hourStart = mktime(&entryTime);
+            memcpy(cachedHour, line, 13);
+            entryTime.tm_min = minutes;
+            entryTime.tm_sec = seconds;
+        }
+
+        time_t timestamp = hourStart + entryTime.tm_min * 60 + entryTime.tm_sec;
+        if (!CompressedLogAppend(&log, (uint16_t)sensorId, (int64_t)timestamp * 1000, temperature)) {
+            fprintf(stderr, "Ошибка: не удалось записать отсчёт в %s\n", outputPath);
+            CompressedLogClose(&log);
+            fclose(input);
+            return EXIT_FAILURE;
+        }
+    }
+
+    unsigned long long samples = log.samples;
+    CompressedLogClose(&log);
+    fclose(input);
+
+    long long textBytes = fileBytes(inputPath);
+    char indexPath[300];
+    snprintf(indexPath, sizeof(indexPath), "%s.idx", outputPath);
+    long long binaryBytes = fileBytes(outputPath) + fileBytes(indexPath);
+
+    printf("Отсчётов: %llu, пропущено строк: %llu, %lld -> %lld байт (%.1fx)\n",
+           samples, skipped, textBytes, binaryBytes, binaryBytes > 0 ? (double)textBytes / binaryBytes : 0.0);
+    return EXIT_SUCCESS;
+}
+
+typedef struct {
+    FILE *output;
+    TimestampFormatter clock;
+} TextWriter;
+
+static void writeTextSample(void *context, uint16_t sensorId, int64_t timestampMs, double value) {
+    TextWriter *writer = (TextWriter *)context;
+    char timestamp[TIMESTAMP_TEXT_SIZE];
+    TimestampFormat(&writer->clock, (time_t)(timestampMs / 1000), timestamp);
+
+    fprintf(writer->output, "%s %f %u\n", timestamp, value, sensorId);
+}
+
+static int toText(const char *inputPath, const char *outputPath, int64_t fromMs, int64_t toMs, int sensorId) {
+    TextWriter writer = { .output = fopen(outputPath, "w") };
+    TimestampFormatterInit(&writer.clock);
+    if (!writer.output) {
+        perror("Ошибка открытия текстового лога.\n");
+        return EXIT_FAILURE;
+    }
+
+    long long samples = CompressedLogScan(inputPath, fromMs, toMs, sensorId, writeTextSample, &writer);
+    fclose(writer.output);
+
+    if (samples < 0) {
+        fprintf(stderr, "Ошибка: не удалось прочитать сжатый лог %s\n", inputPath);
+        return EXIT_FAILURE;
+    }
+    printf("Отсчётов: %lld\n", samples);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 4 && strcmp(argv[1], "to-binary") == 0) {
+        return toBinary(argv[2], argv[3]);
+    }
+
+    if (argc >= 4 && strcmp(argv[1], "to-text") == 0) {
+        int64_t fromMs = (argc >= 6) ? atoll(argv[4]) * 1000 : INT64_MIN;
+        int64_t toMs = (argc >= 6) ? atoll(argv[5]) * 1000 : INT64_MAX;
+        int sensorId = (argc >= 7) ? atoi(argv[6]) : -1;
+        return toText(argv[2], argv[3], fromMs, toMs, sensorId);
+    }
+
+    fprintf(stderr,
+            "Использование:\n"
+            "  %s to-binary <текстовый лог> <сжатый лог>\n"
+            "  %s to-text <сжатый лог> <текстовый лог> [fromEpoch toEpoch [sensorId]]\n",
+            argv[0], argv[0]);
+    return EXIT_FAILURE;
+}